@@ -18,12 +18,15 @@ struct cardStat {
     }
 };
 
+// marks an unbound ('*') source or target of a query
+const uint32_t ANY_VERTEX = UINT32_MAX;
+
 class Estimator {
 
 public:
 
     virtual void prepare() = 0;
-    virtual cardStat estimate(RPQTree *q) = 0;
+    virtual cardStat estimate(RPQTree *q, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) = 0;
 
 };
 
@@ -9,12 +9,16 @@
 #include <memory>
 #include "Graph.h"
 #include "Estimator.h"
+#include "ResultSink.h"
 
 class Evaluator {
 
 public:
     virtual void prepare() = 0;
-    virtual cardStat evaluate(RPQTree *query) = 0;
+    virtual cardStat evaluate(RPQTree *query, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) = 0;
+
+    // evaluate() that also hands the answer pairs to the sink as they are found
+    virtual cardStat stream(RPQTree *query, ResultSink &sink, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) = 0;
 
 };
 
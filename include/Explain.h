@@ -0,0 +1,42 @@
+#ifndef QS_EXPLAIN_H
+#define QS_EXPLAIN_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Estimator.h"
+
+// One operator of a plan: what the optimizer expected of it and, after EXPLAIN ANALYZE, what it
+// did. Times include the children, so the self time of a node is its time minus theirs.
+struct explainNode {
+    std::string op;   // scan, path-scan, index, expand, join, closure, cached, count, msbfs, pipeline, reach
+    std::string path; // canonical text of the sub-query the operator computes
+    bool estimated = false;
+    cardStat estimate {0, 0, 0};
+
+    bool analyzed = false;
+    cardStat actual {0, 0, 0};
+    uint64_t rowsIn = 0;    // tuples read from the materialized inputs
+    uint64_t rowsRaw = 0;   // tuples produced before duplicates were removed
+    double millis = 0;      // wall time
+    double sortMillis = 0;  // sorting and removing duplicates, summed over threads
+    uint64_t bytesOut = 0;  // size of the materialized output
+    uint64_t peakBytes = 0; // largest amount of relations held at once by the node and its children
+
+    std::vector<explainNode> children;
+};
+
+class Explain {
+
+    static void textNode(const explainNode &node, std::ostream &out, const std::string &indent);
+    static void jsonNode(const explainNode &node, std::ostream &out, const std::string &indent);
+
+public:
+    static void printText(const explainNode &root, std::ostream &out);
+    static void printJson(const explainNode &root, std::ostream &out);
+    static std::string escape(const std::string &text);
+
+};
+
+
+#endif //QS_EXPLAIN_H
@@ -0,0 +1,84 @@
+#ifndef QS_GRAPHGENERATOR_H
+#define QS_GRAPHGENERATOR_H
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// how the edges of one label spread over the vertices
+enum class degreeModel { UNIFORM, ZIPF, POWER_LAW };
+
+struct labelDistribution {
+    degreeModel model = degreeModel::UNIFORM;
+    double exponent = 0; // s of Zipf, or gamma of a power law with P(degree = d) ~ d^-gamma
+
+    // "uniform", "zipf:S" or "powerlaw:GAMMA"
+    static bool parse(const std::string &text, labelDistribution &out);
+};
+
+struct generatorConfig {
+    uint64_t seed = 42;
+    uint32_t noVertices = 10000;
+    uint64_t noEdges = 100000;
+    uint32_t noLabels = 4;
+    std::vector<labelDistribution> distributions; // one per label, the last one repeats
+    double labelSkew = 0;                         // Zipf exponent of the edges per label, 0 for uniform
+
+    uint32_t noQueries = 100;
+    uint32_t minChain = 1;
+    uint32_t maxChain = 5;
+    double boundShare = 0.2;    // queries with a constant source or target
+    double closureShare = 0.1;  // queries with one operand under a bounded closure
+    double inverseShare = 0.25; // operands that follow a label against its direction
+};
+
+// ranks 1..n with P(k) ~ k^-s, by rejection-inversion (Hoermann and Derflinger), in constant time
+// and memory whatever n is
+class ZipfSampler {
+
+    uint64_t n;
+    double s;
+    double hIntegralX1;
+    double hIntegralN;
+    double threshold;
+
+    double h(double x) const;
+    double hIntegral(double x) const;
+    double hIntegralInverse(double x) const;
+
+public:
+    ZipfSampler(uint64_t n, double s);
+
+    uint64_t sample(std::mt19937_64 &rng) const;
+};
+
+// Synthetic graphs in the format read by SimpleGraph::readFromContiguousFile and query workloads in
+// the format of queries.csv. Everything follows from the seed, and edges are written as they are
+// drawn, so graphs of any size take constant memory.
+class GraphGenerator {
+
+    generatorConfig config;
+    std::vector<uint64_t> multipliers; // per label and side, coprime to the number of vertices
+    std::vector<uint64_t> shifts;
+
+    // vertex of the given popularity rank for one label and side; the hubs of every label and side
+    // land on different vertices
+    uint32_t placeRank(uint64_t rank, uint32_t label, bool target) const;
+    uint32_t drawVertex(std::mt19937_64 &rng, const std::vector<ZipfSampler> &samplers, uint32_t label, bool target) const;
+    std::vector<ZipfSampler> samplers() const;
+    const labelDistribution &distributionOf(uint32_t label) const;
+
+public:
+    explicit GraphGenerator(const generatorConfig &c);
+
+    void writeGraph(std::ostream &out) const;
+    void writeQueries(std::ostream &out) const;
+
+    static double uniform(std::mt19937_64 &rng);
+
+};
+
+
+#endif //QS_GRAPHGENERATOR_H
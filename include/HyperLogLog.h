@@ -0,0 +1,23 @@
+#ifndef QS_HYPERLOGLOG_H
+#define QS_HYPERLOGLOG_H
+
+#include <cstdint>
+#include <cstddef>
+
+// HyperLogLog distinct counting over vertex ids. A sketch is a run of m one-byte registers (m a power
+// of two) owned by the caller, so many sketches can share one flat array and be merged in place.
+class HyperLogLog {
+
+public:
+
+    // 64-bit mix of a vertex id; different seeds give independent hashes of the same vertex
+    static uint64_t hash(uint32_t v, uint64_t seed = 0);
+
+    static void add(uint8_t *registers, uint32_t m, uint32_t v);
+    static void merge(uint8_t *into, const uint8_t *from, uint32_t m);
+    static double estimate(const uint8_t *registers, uint32_t m);
+
+};
+
+
+#endif //QS_HYPERLOGLOG_H
@@ -0,0 +1,53 @@
+#ifndef QS_JOINKERNELS_H
+#define QS_JOINKERNELS_H
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+class RelationPool;
+
+// work of one operator, filled in by the kernels when a caller asks for it (EXPLAIN ANALYZE)
+struct kernelStats {
+    uint64_t rawTuples = 0; // produced before duplicates were removed
+    uint64_t sortNanos = 0; // spent sorting and removing duplicates, summed over threads
+
+    void add(const kernelStats &other);
+    static uint64_t now();
+};
+
+// Join kernels over binary relations. Every kernel returns its output sorted on (first, second)
+// and without duplicates, which is the form all relations in the evaluator are kept in.
+// Given a RelationPool, outputs and temporary buffers are taken from it instead of the heap.
+class JoinKernels {
+
+public:
+
+    enum kernel { MERGE, HASH };
+
+    // partitions are sized so the build side of one partition fits in the L2 cache
+    static const uint32_t partitionTuples = 1 << 15;
+    // cost of one galloping step of the merge kernel, in sequential passes over one tuple
+    static const uint32_t gallopCost = 3;
+    // inputs smaller than this are joined on the calling thread even when a pool is given
+    static const uint32_t parallelThreshold = 1 << 15;
+
+    static kernel choose(bool leftSorted, bool rightSorted, size_t leftSize, size_t rightSize);
+
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> mergeJoin(const std::vector<std::pair<uint32_t,uint32_t>> &left, const std::vector<std::pair<uint32_t,uint32_t>> &right, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> hashJoin(const std::vector<std::pair<uint32_t,uint32_t>> &left, const std::vector<std::pair<uint32_t,uint32_t>> &right, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static void mergeJoinRange(const std::vector<std::pair<uint32_t,uint32_t>> &left, size_t begin, size_t end, const std::vector<std::pair<uint32_t,uint32_t>> &right, std::vector<std::pair<uint32_t,uint32_t>> &out, kernelStats *stats = nullptr);
+
+    static std::vector<size_t> groupBounds(const std::vector<std::pair<uint32_t,uint32_t>> &relation, uint32_t parts);
+    static void concat(std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &runs, std::vector<std::pair<uint32_t,uint32_t>> &out);
+
+    static void radixSort(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers = nullptr);
+    static void sortUnique(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers = nullptr);
+    static void sorted(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers = nullptr);
+
+};
+
+
+#endif //QS_JOINKERNELS_H
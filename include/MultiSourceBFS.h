@@ -0,0 +1,41 @@
+#ifndef QS_MULTISOURCEBFS_H
+#define QS_MULTISOURCEBFS_H
+
+#include <memory>
+#include <vector>
+#include "SimpleGraph.h"
+#include "RPQTree.h"
+#include "Estimator.h"
+
+// Evaluates a path for a batch of 64 sources at once (MS-BFS): every vertex of the frontier carries
+// a bitmask of the sources that reach it, so a vertex shared by several sources is expanded once
+// per batch instead of once per pair, and no intermediate relation is materialized.
+class MultiSourceBFS {
+
+    std::shared_ptr<SimpleGraph> graph;
+
+    // vertices of a frontier sorted ascending, with the sources of the batch that reach them
+    typedef std::vector<std::pair<uint32_t,uint64_t>> frontier;
+
+    // scratch of step(), indexed by vertex
+    std::vector<uint64_t> acc;
+    std::vector<uint32_t> touched;
+
+    frontier step(const frontier &in, uint32_t label, bool inverse);
+    frontier advance(RPQTree *q, const frontier &in);
+    static frontier unite(const frontier &a, const frontier &b);
+    static frontier subtract(const frontier &a, const frontier &b);
+
+public:
+
+    static const uint32_t batchSize = 64;
+
+    explicit MultiSourceBFS(std::shared_ptr<SimpleGraph> &g);
+    ~MultiSourceBFS() = default;
+
+    cardStat count(RPQTree *q);
+
+};
+
+
+#endif //QS_MULTISOURCEBFS_H
@@ -0,0 +1,42 @@
+#ifndef QS_PATHINDEX_H
+#define QS_PATHINDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SimpleGraph.h"
+#include "RPQTree.h"
+#include "Estimator.h"
+
+// Materialized length-2 label paths such as 0+/3-, each one a CSR index of its own sorted by
+// source, so a concatenation of two labels can be read like a single label. The paths to build
+// come from a list of frequent ones, or are chosen from every label pair by estimated benefit;
+// either way a path is only built if its estimated size fits in what is left of the memory budget.
+class PathIndex {
+
+    std::unordered_map<std::string, CSRIndex> paths;
+    size_t bytes = 0;
+    double buildTime = 0; // ms
+
+    static void buildPath(SimpleGraph &g, const std::string &text, CSRIndex &out);
+    static cardStat estimate(SimpleGraph &g, uint32_t a, bool inverseA, uint32_t b, bool inverseB, std::vector<cardStat> &atoms);
+    static std::vector<std::string> choose(SimpleGraph &g);
+
+public:
+
+    void build(SimpleGraph &g, const std::vector<std::string> &frequent, size_t budget);
+    void clear();
+
+    const CSRIndex *find(RPQTree *q) const;
+    const CSRIndex *find(const std::string &text) const;
+
+    size_t size() const;
+    size_t getBytes() const;
+    double getBuildTime() const;
+
+    static bool isPair(const std::string &text);
+
+};
+
+
+#endif //QS_PATHINDEX_H
@@ -0,0 +1,61 @@
+#ifndef QS_PIPELINE_H
+#define QS_PIPELINE_H
+
+#include <memory>
+#include <vector>
+#include "SimpleGraph.h"
+#include "RPQTree.h"
+#include "Estimator.h"
+#include "RelationPool.h"
+
+struct cardCounter;
+
+// Evaluates a chain of labels without materializing any intermediate relation: (source, vertex)
+// pairs flow through the chain in fixed-size batches, and every stage probes the index of its label
+// for the pairs of the stage before it (index nested loops). Sources are scanned in order and every
+// stage keeps that order, so the pairs of one source are finished before those of the next: a stamp
+// per vertex and stage drops the pairs a source already produced there, and the last stage is
+// counted at the sink instead of kept. Memory is a batch and a stamp array per stage.
+class Pipeline {
+
+    struct stage {
+        const CSRIndex *index = nullptr;
+        std::vector<std::pair<uint32_t,uint32_t>> batch; // pairs waiting for the next stage
+        std::vector<uint32_t> seen;                      // 1 + the last source that reached a vertex here
+    };
+
+    std::shared_ptr<SimpleGraph> graph;
+    std::vector<stage> stages;
+
+    cardCounter *sink = nullptr;
+    uint32_t sinkSource = UINT32_MAX;
+    uint64_t rawPairs = 0;
+    uint64_t liveBytes = 0; // capacity of the batches, stamp arrays and counter allocated so far
+    uint64_t peakBytes = 0;
+
+    static bool chain(RPQTree *q, std::vector<std::pair<uint32_t,bool>> &labels);
+    void emit(size_t i, uint32_t source, uint32_t target);
+    void flush(size_t i);
+    void hold(uint64_t bytes);
+
+public:
+
+    static const uint32_t batchSize = 1024;
+
+    explicit Pipeline(std::shared_ptr<SimpleGraph> &g);
+    ~Pipeline() = default;
+
+    // a concatenation of labels, closures are left to the materializing evaluator
+    static bool supports(RPQTree *q);
+
+    // exact cardinalities of q; backward runs the inverse chain from the targets
+    cardStat count(RPQTree *q, bool backward = false, RelationPool *buffers = nullptr);
+
+    uint64_t getRawPairs() const;
+    // the most bytes of batches and per-vertex arrays held at once by the last count()
+    uint64_t getPeakBytes() const;
+
+};
+
+
+#endif //QS_PIPELINE_H
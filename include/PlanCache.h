@@ -0,0 +1,49 @@
+#ifndef QS_PLANCACHE_H
+#define QS_PLANCACHE_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RPQTree.h"
+
+// Bounded LRU cache of join orders, keyed by the canonical text of a query. A join order is the
+// list of split points of the plan in pre-order, so it can be replayed over the operands of any
+// query with the same canonical form. Entries belong to one version of the graph and statistics
+// and are dropped as soon as a different version is asked for.
+class PlanCache {
+
+    typedef std::pair<std::string, std::vector<uint32_t>> entry;
+
+    size_t capacity;
+    std::list<entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> lookup;
+    uint64_t version;
+    std::mutex lock;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> planningNanos; // time spent planning the misses
+
+    void reset(uint64_t newVersion);
+
+public:
+
+    explicit PlanCache(size_t capacity = 1024);
+
+    bool get(const std::string &key, uint64_t version, std::vector<uint32_t> &order);
+    void put(const std::string &key, uint64_t version, std::vector<uint32_t> order, uint64_t nanos);
+    void clear();
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    double getPlanningTime() const;
+
+    static std::string canonical(RPQTree *q);
+
+};
+
+
+#endif //QS_PLANCACHE_H
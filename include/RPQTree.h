@@ -7,6 +7,10 @@
 
 #include <string>
 #include <algorithm>
+#include <cstdint>
+
+// upper bound of an unbounded closure such as '*' or '+'
+const uint32_t UNBOUNDED = UINT32_MAX;
 
 class RPQTree {
 
@@ -22,6 +26,8 @@ public:
     void print();
 
     bool isConcat();
+    bool isClosure();
+    void closureBounds(uint32_t &min, uint32_t &max);
 
     bool isLeaf();
     bool isUnary();
@@ -0,0 +1,82 @@
+#ifndef QS_RELATIONPOOL_H
+#define QS_RELATIONPOOL_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Buffers for intermediate relations and per-vertex scratch arrays that outlive the operators and
+// queries that use them. A relation handed out by the pool is an ordinary shared vector whose
+// deleter gives the buffer back with its capacity, so the outputs and sort buffers of later
+// operators are carved out of memory that is already mapped instead of grown from scratch. Free
+// buffers are kept up to a byte budget and the best fitting one is reused first.
+//
+// The pool must be owned by a shared_ptr; relations that outlive it free their buffers normally.
+class RelationPool : public std::enable_shared_from_this<RelationPool> {
+
+    template<typename T>
+    using freeList = std::multimap<size_t, std::vector<T>>; // by capacity
+
+    size_t budget; // bytes
+    size_t used = 0;
+    std::mutex lock;
+    freeList<std::pair<uint32_t,uint32_t>> relations;
+    freeList<uint32_t> arrays;
+
+    std::atomic<uint64_t> reused;
+    std::atomic<uint64_t> allocated;
+    std::atomic<uint64_t> dropped; // buffers freed because the budget was full
+
+    template<typename T>
+    std::vector<T> take(freeList<T> &list, size_t expected);
+    template<typename T>
+    void give(freeList<T> &list, std::vector<T> &&buffer);
+
+public:
+
+    // a free buffer is handed out for requests down to half its capacity minus this many elements
+    static const size_t slack = 1 << 12;
+
+    // a per-vertex array borrowed for the lifetime of the object, zero-filled
+    class scratch {
+        RelationPool *owner;
+    public:
+        std::vector<uint32_t> data;
+
+        scratch(RelationPool *owner, size_t size);
+        ~scratch();
+        scratch(const scratch &) = delete;
+        scratch &operator=(const scratch &) = delete;
+
+        // size zeros, in a buffer from the pool if the current one is too small
+        void reset(size_t size);
+
+        uint32_t &operator[](size_t i) { return data[i]; }
+        uint32_t operator[](size_t i) const { return data[i]; }
+    };
+
+    explicit RelationPool(size_t budget);
+    ~RelationPool() = default;
+
+    // an empty relation with room for at least expected pairs, back in the pool once it is dropped
+    std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> relation(size_t expected);
+    std::vector<std::pair<uint32_t,uint32_t>> buffer(size_t expected);
+    void recycle(std::vector<std::pair<uint32_t,uint32_t>> &&buffer);
+    std::vector<uint32_t> array(size_t expected);
+    void recycle(std::vector<uint32_t> &&array);
+    void clear();
+
+    // a relation from the pool if there is one, a fresh vector otherwise
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> relation(RelationPool *pool, size_t expected);
+
+    uint64_t getReused() const;
+    uint64_t getAllocated() const;
+    uint64_t getDropped() const;
+    size_t getBytesPooled();
+
+};
+
+
+#endif //QS_RELATIONPOOL_H
@@ -0,0 +1,53 @@
+#ifndef QS_RESULTCACHE_H
+#define QS_RESULTCACHE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Materialized intermediate relations shared across queries, keyed by the canonical text of the
+// sub-path that produced them (see PlanCache::canonical). Relations are always kept sorted by
+// source, so the text alone identifies one. The least recently used relations are evicted once the
+// cached pairs exceed the memory budget; like the plan cache, entries belong to one graph version.
+class ResultCache {
+
+    typedef std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> relation;
+    typedef std::pair<std::string, relation> entry;
+
+    size_t budget; // bytes
+    size_t used;
+    std::list<entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> lookup;
+    uint64_t version;
+    mutable std::mutex lock;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+
+    static size_t bytes(const entry &e);
+    void reset(uint64_t newVersion);
+
+public:
+
+    explicit ResultCache(size_t budget);
+
+    relation get(const std::string &key, uint64_t version);
+    bool contains(const std::string &key, uint64_t version) const;
+    void put(const std::string &key, uint64_t version, relation &result);
+    void clear();
+
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+    uint64_t getEvictions() const;
+    size_t getBytesUsed() const;
+    double getHitRate() const;
+
+};
+
+
+#endif //QS_RESULTCACHE_H
@@ -0,0 +1,108 @@
+#ifndef QS_RESULTSINK_H
+#define QS_RESULTSINK_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Receives the answer of a query as batches of (source, target) pairs, in the vertex ids of the
+// input. Every pair is delivered once and the pairs of a source are delivered together. A batch is
+// the evaluator's own buffer, lent to consume() for the duration of the call or given to take(); the
+// evaluator waits for either to return, so a slow consumer holds the engine back instead of piling
+// up results.
+class ResultSink {
+
+public:
+    virtual ~ResultSink() = default;
+
+    virtual void consume(const std::pair<uint32_t,uint32_t> *pairs, size_t count) = 0;
+
+    // a batch the evaluator is done with; a sink may keep the buffer by swapping it for an empty one
+    virtual void take(std::vector<std::pair<uint32_t,uint32_t>> &batch) {
+        consume(batch.data(), batch.size());
+        batch.clear();
+    }
+
+    // after the last batch of a query
+    virtual void finish() {}
+
+};
+
+// hands every batch to a function
+class CallbackSink : public ResultSink {
+
+public:
+    using callback = std::function<void(const std::pair<uint32_t,uint32_t> *pairs, size_t count)>;
+
+    explicit CallbackSink(callback f);
+
+    void consume(const std::pair<uint32_t,uint32_t> *pairs, size_t count) override ;
+
+private:
+    callback f;
+
+};
+
+// Writes the pairs to a file or pipe, as "source target" lines or as pairs of native-endian uint32.
+// The writes happen on a thread of their own: take() queues the evaluator's batch buffer itself and
+// hands an emptied one back, consume() has to copy the batch into a spare buffer. Both block while
+// queueDepth batches wait, so a slow file or reader throttles the evaluator with a bounded amount of
+// memory in between. The first failed write is thrown from the next call to consume(), take() or
+// finish(); the batches after it are dropped.
+class FileSink : public ResultSink {
+
+public:
+    enum format { TEXT, BINARY };
+
+    explicit FileSink(const std::string &fileName, format fmt = TEXT, size_t queueDepth = 4);
+    explicit FileSink(FILE *stream, format fmt = TEXT, size_t queueDepth = 4);
+    ~FileSink() override ;
+
+    FileSink(const FileSink &) = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    static bool parseFormat(const std::string &name, format &fmt);
+
+    void consume(const std::pair<uint32_t,uint32_t> *pairs, size_t count) override ;
+    void take(std::vector<std::pair<uint32_t,uint32_t>> &batch) override ;
+
+    // returns once everything queued is written and flushed
+    void finish() override ;
+
+    uint64_t getPairsWritten();
+    uint64_t getStalls();  // batches that waited for room in the queue
+
+private:
+    FILE *out;
+    bool owned;
+    format fmt;
+    size_t queueDepth;
+
+    std::deque<std::vector<std::pair<uint32_t,uint32_t>>> queued;
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> spare;
+    std::vector<char> text;
+    std::string error; // the first failed write, if any
+    bool writing = false;
+    bool stopping = false;
+    uint64_t written = 0;
+    uint64_t stalls = 0;
+
+    std::mutex lock;
+    std::condition_variable ready;   // a batch is queued or the sink is closing
+    std::condition_variable room;    // the queue is below its depth
+    std::condition_variable drained; // nothing is queued or being written
+    std::thread writer;
+
+    void work();
+    bool write(const std::vector<std::pair<uint32_t,uint32_t>> &batch);
+    void check();
+
+};
+
+
+#endif //QS_RESULTSINK_H
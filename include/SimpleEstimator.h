@@ -8,16 +8,98 @@
 #include "Estimator.h"
 #include "SimpleGraph.h"
 
+// one operand of a concatenation chain: its statistics and, for a label, the atom it reads
+// (2 * label + 1 for an inverse label), or NO_ATOM for anything else such as a closure
+const int32_t NO_ATOM = -1;
+
+struct chainAtom {
+    cardStat stats;
+    int32_t atom;
+};
+
+// statistics of a label read in one direction
+struct atomSynopsis {
+    cardStat stats {0, 0, 0};
+
+    // vertices with an out-degree in [2^b, 2^(b+1)) and the sum of their degrees, per bucket b
+    std::vector<uint32_t> histogramVertices;
+    std::vector<uint64_t> histogramDegrees;
+
+    // the vertices with the largest out-degrees, (vertex, degree) by decreasing degree
+    std::vector<std::pair<uint32_t,uint32_t>> heavyHitters;
+
+    // the targets with the smallest sample hashes, a uniform sample of the targets
+    std::vector<uint32_t> targetSample;
+};
+
+// join of atom A followed by atom B on the targets of A
+struct pairSynopsis {
+    uint64_t joinSize = 0; // paths before removing duplicates
+    uint32_t noOut = 0;    // sources of A that reach B
+    uint32_t noIn = 0;     // targets of B that are reached from A
+    uint32_t noKeys = 0;   // targets of A that B continues from
+    uint64_t keyEdges = 0; // edges of B leaving those join keys
+};
+
 class SimpleEstimator : public Estimator {
 
     std::shared_ptr<SimpleGraph> graph;
 
+    // filled by prepare(), only read while estimating so estimates can run concurrently
+    uint32_t numLabels = 0;
+    uint32_t numAtoms = 0;
+    std::vector<atomSynopsis> atomData;
+    // per atom A, the (B, synopsis) of every atom B that continues from a target of A, by B; any
+    // other pair joins to nothing
+    std::vector<std::vector<std::pair<uint32_t,pairSynopsis>>> partners;
+
+    // HyperLogLog sketches of the neighbours of every vertex with out-edges in an atom, sketchRegisters
+    // bytes for the vertex at rank i of sketchVertices[a]; none when the budget over all atoms cannot
+    // hold at least minRegisters per such vertex, and the estimates fall back to the synopses alone
+    size_t sketchBudget = 64 << 20;
+    uint32_t sketchRegisters = 0;
+    std::vector<std::vector<uint32_t>> sketchVertices;
+    std::vector<std::vector<uint8_t>> sketches;
+
+    static const uint32_t noHeavyHitters = 16;
+    static const uint32_t sampleSize = 64;
+    static const uint64_t sampleSeed = 0x5851f42d4c957f2dull;
+    static const uint32_t minRegisters = 16;
+    static const uint32_t maxRegisters = 256;
+
+    // a row of synopses over all atoms B, for the atom A being counted, and the Bs it touched
+    struct pairScratch {
+        std::vector<pairSynopsis> row;
+        std::vector<uint8_t> used;
+        std::vector<uint32_t> touched;
+        std::vector<uint64_t> stamp;
+        uint64_t current = 0;
+    };
+
+    void countDegrees(uint32_t label, std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &nonEmpty);
+    void countPairs(uint32_t a, const std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &nonEmpty, const std::vector<uint32_t> &start, const std::vector<std::pair<uint32_t,uint32_t>> &present, pairScratch &scratch);
+    const pairSynopsis &pairOf(uint32_t a, uint32_t b) const;
+    double degreeOf(uint32_t atom, uint32_t v) const;
+    const uint8_t *sketchOf(uint32_t atom, uint32_t v) const;
+    std::vector<double> reach(const std::vector<chainAtom> &atoms, size_t begin, size_t end, bool backward) const;
+    cardStat combine(const std::vector<chainAtom> &atoms, size_t begin, size_t end, double sketchOut, double sketchIn) const;
+
 public:
     explicit SimpleEstimator(std::shared_ptr<SimpleGraph> &g);
     ~SimpleEstimator() = default;
 
+    void setSketchBudget(size_t bytes);
     void prepare() override ;
-    cardStat estimate(RPQTree *q) override ;
+    cardStat estimate(RPQTree *q, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) override ;
+    cardStat estimateUnbound(RPQTree *q);
+    cardStat estimateClosure(RPQTree *q);
+    void treeToList(RPQTree *q, std::vector<chainAtom> &atoms);
+    cardStat combine(const std::vector<chainAtom> &atoms, size_t begin, size_t end) const;
+    void combineAll(const std::vector<chainAtom> &atoms, std::vector<std::vector<cardStat>> &card) const;
+
+    static cardStat chain(const std::vector<cardStat> &atoms);
+    static cardStat chain(const std::vector<cardStat> &atoms, size_t begin, size_t end);
+    static double distinct(double paths, double cells);
 
 };
 
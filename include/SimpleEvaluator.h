@@ -8,37 +8,155 @@
 
 #include <memory>
 #include <cmath>
+#include <chrono>
 #include "SimpleGraph.h"
+#include "SimpleEstimator.h"
 #include "RPQTree.h"
 #include "Evaluator.h"
 #include "Graph.h"
+#include "ThreadPool.h"
+#include "PlanCache.h"
+#include "ResultCache.h"
+#include "PathIndex.h"
+#include "JoinKernels.h"
+#include "Explain.h"
+#include "RelationPool.h"
+#include "ResultSink.h"
+
+// accumulates exact cardinalities one source at a time, without keeping the pairs
+struct cardCounter {
+    RelationPool::scratch stamp; // 1 + the last source that reached a vertex
+    RelationPool::scratch reachedAny;
+    uint32_t current = 0;
+    uint32_t reached = 0;
+    cardStat stats {0, 0, 0};
+
+    explicit cardCounter(uint32_t noVertices, RelationPool *buffers = nullptr) : stamp(buffers, noVertices), reachedAny(buffers, noVertices) {}
+
+    void beginSource(uint32_t source) {
+        current = source + 1;
+        reached = 0;
+    }
+
+    // false if the target was already reached from the current source
+    bool add(uint32_t target) {
+        if(stamp[target] == current) return false;
+        stamp[target] = current;
+        reached++;
+        stats.noPaths++;
+        if(reachedAny[target] == 0) {
+            reachedAny[target] = 1;
+            stats.noIn++;
+        }
+        return true;
+    }
+
+    void endSource() {
+        if(reached > 0) stats.noOut++;
+    }
+};
+
+// collects answer pairs into batches for a sink, translated back to the vertex ids of the input; the
+// sink may keep a full batch and leave an empty buffer in its place
+struct resultBatch {
+    static const size_t batchSize = 1 << 13;
+
+    ResultSink &sink;
+    const SimpleGraph &graph;
+    std::vector<std::pair<uint32_t,uint32_t>> pairs;
+
+    resultBatch(ResultSink &sink, const SimpleGraph &graph) : sink(sink), graph(graph) {
+        pairs.reserve(batchSize);
+    }
+
+    void add(uint32_t source, uint32_t target) {
+        pairs.emplace_back(source, target);
+        if(pairs.size() == batchSize) flush();
+    }
+
+    void flush() {
+        if(pairs.empty()) return;
+        if(graph.isReordered())
+            for(auto &pair : pairs) pair = {graph.externalId(pair.first), graph.externalId(pair.second)};
+        sink.take(pairs);
+        pairs.reserve(batchSize);
+    }
+};
 
 class SimpleEvaluator : public Evaluator {
 
     std::shared_ptr<SimpleGraph> graph;
     std::shared_ptr<SimpleEstimator> est;
+    std::shared_ptr<ThreadPool> pool;
+    PlanCache plans;
+    std::shared_ptr<ResultCache> results;
+    std::shared_ptr<RelationPool> buffers;
+
+    PathIndex twoHop;
+    std::vector<std::string> frequentPaths;
+    size_t pathBudget = 0;
+
+    bool pipelined = false;
 
 public:
 
+    // estimated intermediate pairs above which the multi-source BFS engine is used
+    static const uint64_t msbfsThreshold = 1 << 20;
+
     explicit SimpleEvaluator(std::shared_ptr<SimpleGraph> &g);
     ~SimpleEvaluator() = default;
 
     void prepare() override ;
-    cardStat evaluate(RPQTree *query) override ;
+    cardStat evaluate(RPQTree *query, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) override ;
+    cardStat stream(RPQTree *query, ResultSink &sink, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX) override ;
 
     void attachEstimator(std::shared_ptr<SimpleEstimator> &e);
-
-    std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> evaluate_aux(RPQTree *q);
-    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> project(uint32_t label, bool inverse, std::shared_ptr<SimpleGraph> &g);
-    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right);
+    void attachPool(std::shared_ptr<ThreadPool> &p);
+    void attachResultCache(std::shared_ptr<ResultCache> &r);
+    void attachRelationPool(std::shared_ptr<RelationPool> &b);
+    void setPipelining(bool enabled);
+    PlanCache &getPlanCache();
+    void configurePathIndex(const std::vector<std::string> &frequent, size_t budget);
+    const PathIndex &getPathIndex() const;
+
+    std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> evaluate_aux(RPQTree *q, explainNode *node = nullptr);
+    std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> materialize(RPQTree *q, explainNode *node = nullptr);
+    std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> measure(RPQTree *q, explainNode *node);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> project(uint32_t label, bool inverse, std::shared_ptr<SimpleGraph> &g, ThreadPool *pool = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> project(const CSRIndex &index, ThreadPool *pool = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> expand(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, uint32_t label, bool inverse, std::shared_ptr<SimpleGraph> &g, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> expand(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, const CSRIndex &index, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> closure(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &base, uint32_t min, uint32_t max, uint32_t noVertices, ThreadPool *pool = nullptr, kernelStats *stats = nullptr, RelationPool *buffers = nullptr);
+    static void appendGroup(uint32_t source, std::vector<uint32_t> &targets, std::vector<std::pair<uint32_t,uint32_t>> &out);
+    static bool parseLabel(const std::string &data, uint32_t &label, bool &inverse);
+
+    std::vector<uint32_t> reach(RPQTree *q, std::vector<uint32_t> frontier, bool backward);
+    cardStat evaluateBound(RPQTree *query, uint32_t s, uint32_t t);
+    cardStat pipeline(RPQTree *query, explainNode *node = nullptr);
 
     std::vector<RPQTree*> find_leaves(RPQTree *query);
-    RPQTree* best = nullptr;
-    RPQTree* query_optimizer(RPQTree *query);
-    void query_optimizer2(std::vector<RPQTree*> query, uint32_t sum);
+    RPQTree* optimize(RPQTree *query);
+    void chainShortcuts(const std::vector<RPQTree*> &operands, std::vector<bool> &indexed, std::vector<std::vector<bool>> &cached);
+    std::vector<std::vector<cardStat>> estimateChain(const std::vector<RPQTree*> &operands);
+    std::vector<std::vector<cardStat>> exactChain(const std::vector<RPQTree*> &operands);
+    double planChain(const std::vector<RPQTree*> &operands, const std::vector<std::vector<cardStat>> &card, std::vector<std::vector<size_t>> &split);
+    double planCost(const std::vector<RPQTree*> &operands, const std::vector<std::vector<cardStat>> &card, const std::vector<std::vector<size_t>> &split);
+    static RPQTree* buildPlan(const std::vector<RPQTree*> &operands, const std::vector<std::vector<size_t>> &split, size_t i, size_t j, std::vector<uint32_t> &order);
+    static RPQTree* replayPlan(std::vector<RPQTree*> &operands, const std::vector<uint32_t> &order, size_t &next, size_t i, size_t j);
+    static void releasePlan(RPQTree *plan);
 
 
     static cardStat computeStats(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &g);
+    cardStat countStats(RPQTree *q, explainNode *node = nullptr, resultBatch *sink = nullptr);
+
+    explainNode explain(RPQTree *query, uint32_t s = ANY_VERTEX, uint32_t t = ANY_VERTEX, bool analyze = false);
+    void describe(RPQTree *plan, explainNode &node, bool root);
+    void beginNode(RPQTree *q, explainNode &node);
+    void endNode(explainNode &node, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &result, std::chrono::steady_clock::time_point start);
+    void indexNode(RPQTree *q, explainNode *node);
+    uint64_t intermediateSize(RPQTree *plan, bool root);
+    static void offsets(const std::vector<std::pair<uint32_t,uint32_t>> &relation, std::vector<uint32_t> &pos);
 
 };
 
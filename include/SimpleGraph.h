@@ -5,6 +5,8 @@
 #ifndef QS_SIMPLEGRAPH_H
 #define QS_SIMPLEGRAPH_H
 
+#include <algorithm>
+#include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -13,23 +15,195 @@
 #include <fstream>
 #include "Graph.h"
 
+// compressed sparse row index of a single label: the neighbours of vertex v are
+// neighbours[offsets[v] .. offsets[v+1]), sorted ascending and without duplicates.
+// The arrays either live in the owned vectors or in a memory-mapped snapshot.
+//
+// After compress() the plain arrays are replaced by delta + varint coded lists: a bitmap marks the
+// vertices that have neighbours, and the list of such a vertex starts at a byte offset found through
+// the rank of its bit. A list is its degree followed by the gaps between consecutive neighbours.
+// Neighbours are read through forEach() and appendTo() in either form.
+struct CSRIndex {
+    const uint32_t *offsets = nullptr;
+    const uint32_t *neighbours = nullptr;
+    uint32_t noVertices = 0;
+    uint32_t noNeighbours = 0;
+    uint32_t noNonEmpty = 0; // vertices with at least one neighbour
+
+    std::vector<uint32_t> ownedOffsets;
+    std::vector<uint32_t> ownedNeighbours;
+
+    bool compressed = false;
+    std::vector<uint64_t> present;      // bit v is set if v has neighbours
+    std::vector<uint32_t> presentRank;  // set bits before every word of present
+    std::vector<uint32_t> listStarts;   // byte offset of the list of every vertex with neighbours
+    std::vector<uint8_t> packed;
+
+    CSRIndex() = default;
+    CSRIndex(const CSRIndex &) = delete;
+    CSRIndex(CSRIndex &&) = default;
+    CSRIndex &operator=(CSRIndex &&) = default;
+
+    static uint32_t readVarint(const uint8_t *&p) {
+        uint32_t value = *p & 0x7Fu;
+        for(uint32_t shift = 7; *p++ & 0x80u; shift += 7)
+            value |= (uint32_t) (*p & 0x7Fu) << shift;
+        return value;
+    }
+
+    // start of the coded list of v, nullptr if v has no neighbours
+    const uint8_t *list(uint32_t v) const {
+        uint64_t word = present[v >> 6];
+        uint64_t bit = 1ull << (v & 63);
+        if((word & bit) == 0) return nullptr;
+        return packed.data() + listStarts[presentRank[v >> 6] + __builtin_popcountll(word & (bit - 1))];
+    }
+
+    uint32_t degree(uint32_t v) const {
+        if(!compressed) return offsets[v + 1] - offsets[v];
+        const uint8_t *p = list(v);
+        return p == nullptr ? 0 : readVarint(p);
+    }
+
+    // f(n) for every neighbour n of v, in ascending order
+    template<typename F>
+    void forEach(uint32_t v, F f) const {
+        if(!compressed) {
+            for(auto n = neighbours + offsets[v], last = neighbours + offsets[v + 1]; n != last; n++)
+                f(*n);
+            return;
+        }
+
+        const uint8_t *p = list(v);
+        if(p == nullptr) return;
+        uint32_t n = 0;
+        for(uint32_t count = readVarint(p); count > 0; count--) {
+            n += readVarint(p);
+            f(n);
+        }
+    }
+
+    // f(v, n) for every pair with from <= v < to, in order; the coded lists are read front to back
+    template<typename F>
+    void scan(uint32_t from, uint32_t to, F f) const {
+        if(!compressed) {
+            for(uint32_t v = from; v < to; v++)
+                for(uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+                    f(v, neighbours[i]);
+            return;
+        }
+
+        const uint8_t *p = nullptr;
+        for(uint32_t w = from >> 6; w <= (to - 1) >> 6 && from < to; w++) {
+            uint64_t bits = present[w];
+            if(w == from >> 6) bits &= ~0ull << (from & 63);
+            if(w == (to - 1) >> 6 && (to & 63) != 0) bits &= ~(~0ull << (to & 63));
+            for(; bits != 0; bits &= bits - 1) {
+                auto v = (uint32_t) (w * 64 + __builtin_ctzll(bits));
+                if(p == nullptr) p = list(v);
+                uint32_t n = 0;
+                for(uint32_t count = readVarint(p); count > 0; count--) {
+                    n += readVarint(p);
+                    f(v, n);
+                }
+            }
+        }
+    }
+
+    // f(v, degree) for every v with neighbours, in order; the coded form only visits the set bits
+    template<typename F>
+    void forEachNonEmpty(F f) const {
+        if(!compressed) {
+            for(uint32_t v = 0; v < noVertices; v++)
+                if(offsets[v + 1] != offsets[v]) f(v, offsets[v + 1] - offsets[v]);
+            return;
+        }
+
+        for(size_t w = 0; w < present.size(); w++) {
+            for(uint64_t bits = present[w]; bits != 0; bits &= bits - 1) {
+                auto v = (uint32_t) (w * 64 + __builtin_ctzll(bits));
+                const uint8_t *p = list(v);
+                f(v, readVarint(p));
+            }
+        }
+    }
+
+    // append at most limit neighbours of v to out, false if some were left out
+    bool appendTo(uint32_t v, std::vector<uint32_t> &out, uint32_t limit = UINT32_MAX) const {
+        if(!compressed) {
+            uint32_t d = offsets[v + 1] - offsets[v];
+            out.insert(out.end(), neighbours + offsets[v], neighbours + offsets[v] + std::min(d, limit));
+            return d <= limit;
+        }
+
+        const uint8_t *p = list(v);
+        if(p == nullptr) return true;
+        uint32_t d = readVarint(p);
+        uint32_t n = 0;
+        for(uint32_t i = 0; i < d && i < limit; i++) {
+            n += readVarint(p);
+            out.push_back(n);
+        }
+        return d <= limit;
+    }
+
+    uint32_t size() const { return noNeighbours; }
+    size_t bytes() const;
+
+    void build(uint32_t n, std::vector<std::pair<uint32_t,uint32_t>> &edges);
+    void view(uint32_t n, uint32_t m, uint32_t nonEmpty, const uint32_t *offsetData, const uint32_t *neighbourData);
+    void compress();
+    void decode(std::vector<uint32_t> &offsetsOut, std::vector<uint32_t> &neighboursOut) const;
+};
+
 class SimpleGraph : public Graph {
 public:
-    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> adj;
+    // vertex numberings reorder() can give the indexes: by descending degree, breadth-first from the
+    // hubs, or reverse Cuthill-McKee; vertices without edges go last in every one of them
+    enum ordering { ORIGINAL, DEGREE, BFS, RCM };
+
+    // per-label indexes, fwd by source vertex and rev by target vertex
+    std::vector<CSRIndex> fwd;
+    std::vector<CSRIndex> rev;
 protected:
     uint32_t V;
+    uint32_t E;
     uint32_t L;
 
+    // edges added since the last call to buildIndexes()
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> pending;
+
+    // snapshot the indexes point into, if any
+    void *mapped;
+    size_t mappedSize;
+
+    // bumped every time the indexes change, so anything derived from them can tell it is stale
+    uint64_t version;
+
+    // indexes are compressed once built
+    bool compressIndexes = false;
+
+    // every offset and neighbour of a snapshot is checked when it is opened, not just its layout
+    bool verifySnapshots = false;
+
+    // after reorder(): the index id of every input vertex id and back, empty otherwise
+    std::vector<uint32_t> toInternal;
+    std::vector<uint32_t> toExternal;
+
+    std::vector<uint32_t> orderVertices(ordering order) const;
+
 public:
 
-    SimpleGraph() : V(0), L(0) {};
-    ~SimpleGraph() = default;
+    SimpleGraph() : V(0), E(0), L(0), mapped(nullptr), mappedSize(0), version(0) {};
+    ~SimpleGraph();
     explicit SimpleGraph(uint32_t n);
 
     uint32_t getNoVertices() const override ;
     uint32_t getNoEdges() const override ;
     uint32_t getNoDistinctEdges() const override ;
     uint32_t getNoLabels() const override ;
+    uint64_t getVersion() const;
+    size_t getIndexBytes() const;
 
     static bool sortPairsFirst(const std::pair<uint32_t,uint32_t> &a, const std::pair<uint32_t,uint32_t> &b);
     static bool sortPairsSecond(const std::pair<uint32_t,uint32_t> &a, const std::pair<uint32_t,uint32_t> &b);
@@ -37,8 +211,24 @@ public:
     void addEdge(uint32_t from, uint32_t to, uint32_t edgeLabel) override ;
     void readFromContiguousFile(const std::string &fileName) override ;
 
+    static bool isSnapshot(const std::string &fileName);
+    void writeSnapshot(const std::string &fileName) const;
+    void readFromSnapshot(const std::string &fileName);
+
+    void buildIndexes();
+    void buildIndex(uint32_t label);
+
     void setNoVertices(uint32_t n);
     void setNoLabels(uint32_t noLabels);
+    void setCompression(bool compress);
+    void setSnapshotVerification(bool verify);
+
+    static bool parseOrdering(const std::string &name, ordering &order);
+    void reorder(ordering order);
+    bool isReordered() const;
+    // vertex ids outside the graph (ANY_VERTEX) are passed through
+    uint32_t internalId(uint32_t v) const { return v < toInternal.size() ? toInternal[v] : v; }
+    uint32_t externalId(uint32_t v) const { return v < toExternal.size() ? toExternal[v] : v; }
 
 };
 
@@ -0,0 +1,54 @@
+#ifndef QS_THREADPOOL_H
+#define QS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a deque, runs its own tasks newest first and steals the
+// oldest tasks of the other workers when it runs dry. A thread waiting in parallelFor() runs
+// tasks as well, so operators can fork partitions from inside a task without deadlocking.
+class ThreadPool {
+
+    struct queue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex lock;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<queue>> queues;
+
+    std::atomic<uint64_t> pending;  // submitted and not yet finished
+    std::atomic<uint32_t> next;     // round-robin target of submit()
+
+    std::mutex sleep;
+    std::condition_variable available;
+    std::condition_variable idle;
+    bool stopping;
+
+    bool runOne(uint32_t self);
+    void work(uint32_t self);
+    void push(uint32_t target, std::function<void()> task);
+
+public:
+
+    explicit ThreadPool(uint32_t noThreads);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    void wait();
+
+    // run body(0) .. body(noTasks - 1) on the pool and the calling thread, return when all are done
+    void parallelFor(uint32_t noTasks, const std::function<void(uint32_t)> &body);
+
+    uint32_t size() const;
+
+};
+
+
+#endif //QS_THREADPOOL_H
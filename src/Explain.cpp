@@ -0,0 +1,76 @@
+#include <iomanip>
+#include <sstream>
+#include "Explain.h"
+
+static std::string bytesText(uint64_t bytes) {
+    std::stringstream text;
+    text << std::fixed << std::setprecision(1);
+    if(bytes >= (1u << 20)) text << bytes / 1048576.0 << " MB";
+    else if(bytes >= (1u << 10)) text << bytes / 1024.0 << " kB";
+    else text << bytes << " B";
+    return text.str();
+}
+
+// one line per operator, children indented under it:
+//   join 0+/1+/2+ (est out=.. paths=.. in=..) (actual out=.. paths=.. in=.. rows in=.. raw=.. time=.. ms sort=.. ms peak=..)
+void Explain::textNode(const explainNode &node, std::ostream &out, const std::string &indent) {
+
+    out << indent << (indent.empty() ? "" : "-> ") << node.op << " " << node.path;
+
+    if(node.estimated)
+        out << " (est out=" << node.estimate.noOut << " paths=" << node.estimate.noPaths << " in=" << node.estimate.noIn << ")";
+
+    if(node.analyzed) {
+        out << std::fixed << std::setprecision(3)
+            << " (actual out=" << node.actual.noOut << " paths=" << node.actual.noPaths << " in=" << node.actual.noIn
+            << " rows in=" << node.rowsIn << " raw=" << node.rowsRaw
+            << " time=" << node.millis << " ms sort=" << node.sortMillis << " ms"
+            << " peak=" << bytesText(node.peakBytes) << ")" << std::defaultfloat;
+    }
+    out << std::endl;
+
+    for(const auto &child : node.children)
+        textNode(child, out, indent.empty() ? "  " : indent + "   ");
+}
+
+void Explain::printText(const explainNode &root, std::ostream &out) {
+    textNode(root, out, "");
+}
+
+std::string Explain::escape(const std::string &text) {
+    std::string out;
+    for(auto c : text) {
+        if(c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void Explain::jsonNode(const explainNode &node, std::ostream &out, const std::string &indent) {
+
+    out << indent << "{\"operator\": \"" << node.op << "\", \"path\": \"" << escape(node.path) << "\"";
+
+    if(node.estimated)
+        out << ", \"estimate\": {\"noOut\": " << node.estimate.noOut << ", \"noPaths\": " << node.estimate.noPaths
+            << ", \"noIn\": " << node.estimate.noIn << "}";
+
+    if(node.analyzed) {
+        out << ", \"actual\": {\"noOut\": " << node.actual.noOut << ", \"noPaths\": " << node.actual.noPaths
+            << ", \"noIn\": " << node.actual.noIn << ", \"rows_in\": " << node.rowsIn << ", \"rows_raw\": " << node.rowsRaw
+            << ", \"time_ms\": " << node.millis << ", \"sort_ms\": " << node.sortMillis
+            << ", \"bytes_out\": " << node.bytesOut << ", \"peak_bytes\": " << node.peakBytes << "}";
+    }
+
+    out << ", \"children\": [";
+    for(size_t i = 0; i < node.children.size(); i ++) {
+        out << (i > 0 ? "," : "") << "\n";
+        jsonNode(node.children[i], out, indent + "  ");
+    }
+    if(!node.children.empty()) out << "\n" << indent;
+    out << "]}";
+}
+
+void Explain::printJson(const explainNode &root, std::ostream &out) {
+    jsonNode(root, out, "");
+    out << std::endl;
+}
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstring>
+#include "GraphGenerator.h"
+
+bool labelDistribution::parse(const std::string &text, labelDistribution &out) {
+
+    auto colon = text.find(':');
+    std::string name = text.substr(0, colon);
+    double exponent = 0;
+    if(colon != std::string::npos) {
+        try {
+            exponent = std::stod(text.substr(colon + 1));
+        } catch (std::exception &e) {
+            return false;
+        }
+    }
+
+    if(name == "uniform") out = {degreeModel::UNIFORM, 0};
+    else if(name == "zipf" && exponent > 0) out = {degreeModel::ZIPF, exponent};
+    else if(name == "powerlaw" && exponent > 1) out = {degreeModel::POWER_LAW, exponent};
+    else return false;
+
+    return true;
+}
+
+// (exp(x) - 1) / x and log(1 + x) / x, with their limits at 0
+static double expm1Over(double x) {
+    return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x / 2;
+}
+
+static double log1pOver(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x / 2;
+}
+
+ZipfSampler::ZipfSampler(uint64_t n, double s) : n(std::max<uint64_t>(n, 1)), s(s) {
+    hIntegralX1 = hIntegral(1.5) - 1;
+    hIntegralN = hIntegral(this->n + 0.5);
+    threshold = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+}
+
+double ZipfSampler::h(double x) const {
+    return std::exp(-s * std::log(x));
+}
+
+double ZipfSampler::hIntegral(double x) const {
+    double logX = std::log(x);
+    return expm1Over((1 - s) * logX) * logX;
+}
+
+double ZipfSampler::hIntegralInverse(double x) const {
+    double t = std::max(x * (1 - s), -1.0);
+    return std::exp(log1pOver(t) * x);
+}
+
+uint64_t ZipfSampler::sample(std::mt19937_64 &rng) const {
+
+    while(true) {
+        double u = hIntegralN + GraphGenerator::uniform(rng) * (hIntegralX1 - hIntegralN);
+        double x = hIntegralInverse(u);
+
+        auto k = (uint64_t) std::max(1.0, std::min((double) n, std::floor(x + 0.5)));
+        if(k - x <= threshold || u >= hIntegral(k + 0.5) - h((double) k))
+            return k;
+    }
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while(b != 0) {
+        a %= b;
+        std::swap(a, b);
+    }
+    return a;
+}
+
+// 53 random bits in [0, 1), the same on every platform unlike std::uniform_real_distribution
+double GraphGenerator::uniform(std::mt19937_64 &rng) {
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+GraphGenerator::GraphGenerator(const generatorConfig &c) : config(c) {
+
+    if(config.noVertices == 0) config.noVertices = 1;
+    if(config.noLabels == 0) config.noLabels = 1;
+    if(config.distributions.empty()) config.distributions.emplace_back();
+    if(config.minChain == 0) config.minChain = 1;
+    if(config.maxChain < config.minChain) config.maxChain = config.minChain;
+
+    std::mt19937_64 rng(config.seed ^ 0x9e3779b97f4a7c15ull);
+    for(uint32_t i = 0; i < 2 * config.noLabels; i ++) {
+        uint64_t multiplier = (rng() % config.noVertices) | 1;
+        while(gcd(multiplier, config.noVertices) != 1)
+            multiplier += 2;
+        multipliers.push_back(multiplier % config.noVertices == 0 ? 1 : multiplier);
+        shifts.push_back(rng() % config.noVertices);
+    }
+}
+
+const labelDistribution &GraphGenerator::distributionOf(uint32_t label) const {
+    return config.distributions[std::min<size_t>(label, config.distributions.size() - 1)];
+}
+
+// a power law degree distribution with exponent gamma comes from Zipf ranks with s = 1 / (gamma - 1)
+std::vector<ZipfSampler> GraphGenerator::samplers() const {
+
+    std::vector<ZipfSampler> out;
+    for(uint32_t label = 0; label < config.noLabels; label ++) {
+        const auto &distribution = distributionOf(label);
+        double s = distribution.model == degreeModel::POWER_LAW ? 1 / (distribution.exponent - 1) : distribution.exponent;
+        out.emplace_back(config.noVertices, s);
+    }
+    return out;
+}
+
+uint32_t GraphGenerator::placeRank(uint64_t rank, uint32_t label, bool target) const {
+    size_t i = 2 * label + (target ? 1 : 0);
+    return (uint32_t) ((rank * multipliers[i] + shifts[i]) % config.noVertices);
+}
+
+uint32_t GraphGenerator::drawVertex(std::mt19937_64 &rng, const std::vector<ZipfSampler> &samplers, uint32_t label, bool target) const {
+
+    uint64_t rank;
+    if(distributionOf(label).model == degreeModel::UNIFORM)
+        rank = rng() % config.noVertices;
+    else
+        rank = samplers[label].sample(rng) - 1;
+    return placeRank(rank, label, target);
+}
+
+// text output through a fixed buffer, numbers formatted by hand since that is most of the work
+class lineWriter {
+
+    std::ostream &out;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+public:
+    explicit lineWriter(std::ostream &o) : out(o), buffer(1 << 20) {}
+    ~lineWriter() { flush(); }
+
+    void flush() {
+        out.write(buffer.data(), used);
+        used = 0;
+    }
+
+    void put(const char *text) {
+        size_t length = std::strlen(text);
+        if(used + length > buffer.size()) flush();
+        std::memcpy(buffer.data() + used, text, length);
+        used += length;
+    }
+
+    void put(uint64_t value) {
+        char digits[20];
+        int length = 0;
+        do {
+            digits[length++] = (char) ('0' + value % 10);
+            value /= 10;
+        } while(value > 0);
+
+        if(used + length > buffer.size()) flush();
+        while(length > 0)
+            buffer[used++] = digits[--length];
+    }
+};
+
+// header "noVertices,noEdges,noLabels", then one "source label target ." line per edge; the edges
+// of a label connect vertices drawn from its distribution on both sides
+void GraphGenerator::writeGraph(std::ostream &out) const {
+
+    std::mt19937_64 rng(config.seed);
+    auto vertexSamplers = samplers();
+    ZipfSampler labelSampler(config.noLabels, config.labelSkew);
+
+    lineWriter writer(out);
+    writer.put((uint64_t) config.noVertices);
+    writer.put(",");
+    writer.put(config.noEdges);
+    writer.put(",");
+    writer.put((uint64_t) config.noLabels);
+    writer.put("\n");
+
+    for(uint64_t e = 0; e < config.noEdges; e ++) {
+        auto label = config.labelSkew > 0 ? (uint32_t) labelSampler.sample(rng) - 1 : (uint32_t) (rng() % config.noLabels);
+        auto source = drawVertex(rng, vertexSamplers, label, false);
+        auto target = drawVertex(rng, vertexSamplers, label, true);
+
+        writer.put((uint64_t) source);
+        writer.put(" ");
+        writer.put((uint64_t) label);
+        writer.put(" ");
+        writer.put((uint64_t) target);
+        writer.put(" .\n");
+    }
+}
+
+// chains of random labels and directions, some with a constant end drawn from the distribution of
+// the label at that end (so it likely has paths) and some with one operand repeated 1 to 2 or 3 times
+void GraphGenerator::writeQueries(std::ostream &out) const {
+
+    std::mt19937_64 rng(config.seed + 1);
+    auto vertexSamplers = samplers();
+
+    for(uint32_t q = 0; q < config.noQueries; q ++) {
+        uint32_t length = config.minChain + (uint32_t) (rng() % (config.maxChain - config.minChain + 1));
+
+        std::vector<uint32_t> labels;
+        std::vector<bool> inverse;
+        for(uint32_t i = 0; i < length; i ++) {
+            labels.push_back((uint32_t) (rng() % config.noLabels));
+            inverse.push_back(uniform(rng) < config.inverseShare);
+        }
+
+        bool closure = uniform(rng) < config.closureShare;
+        auto repeated = (uint32_t) (rng() % length);
+        auto upper = 2 + (uint32_t) (rng() % 2);
+
+        std::string path;
+        for(uint32_t i = 0; i < length; i ++) {
+            if(i > 0) path += "/";
+            path += std::to_string(labels[i]) + (inverse[i] ? "-" : "+");
+            if(closure && i == repeated)
+                path += "{1," + std::to_string(upper) + "}";
+        }
+
+        // the vertex a path starts from is a target of the label when it is followed backward
+        std::string s = "*", t = "*";
+        if(uniform(rng) < config.boundShare) {
+            if(rng() % 2 == 0)
+                s = std::to_string(drawVertex(rng, vertexSamplers, labels.front(), inverse.front()));
+            else
+                t = std::to_string(drawVertex(rng, vertexSamplers, labels.back(), !inverse.back()));
+        }
+
+        out << s << "," << path << "," << t << "\n";
+    }
+}
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cmath>
+#include "HyperLogLog.h"
+
+// splitmix64 finalizer
+uint64_t HyperLogLog::hash(uint32_t v, uint64_t seed) {
+    uint64_t x = v + seed + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// the low bits pick the register, which keeps the longest run of leading zeros of the rest
+void HyperLogLog::add(uint8_t *registers, uint32_t m, uint32_t v) {
+
+    uint64_t h = hash(v);
+    uint32_t index = (uint32_t) (h & (m - 1));
+    uint64_t rest = h | (m - 1); // the index bits never count as leading zeros
+    auto rank = (uint8_t) (__builtin_clzll(rest) + 1);
+
+    if(rank > registers[index]) registers[index] = rank;
+}
+
+void HyperLogLog::merge(uint8_t *into, const uint8_t *from, uint32_t m) {
+    for(uint32_t i = 0; i < m; i ++)
+        into[i] = std::max(into[i], from[i]);
+}
+
+// raw estimate with the usual bias constant, linear counting while registers are still empty
+double HyperLogLog::estimate(const uint8_t *registers, uint32_t m) {
+
+    double alpha = m >= 128 ? 0.7213 / (1 + 1.079 / m) : m == 64 ? 0.709 : m == 32 ? 0.697 : 0.673;
+
+    double sum = 0;
+    uint32_t zeros = 0;
+    for(uint32_t i = 0; i < m; i ++) {
+        sum += std::ldexp(1.0, -registers[i]);
+        if(registers[i] == 0) zeros++;
+    }
+
+    double raw = alpha * m * m / sum;
+    if(raw <= 2.5 * m && zeros > 0)
+        return m * std::log((double) m / zeros);
+    return raw;
+}
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include "JoinKernels.h"
+#include "ThreadPool.h"
+#include "RelationPool.h"
+
+void kernelStats::add(const kernelStats &other) {
+    rawTuples += other.rawTuples;
+    sortNanos += other.sortNanos;
+}
+
+uint64_t kernelStats::now() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a temporary buffer from the pool, or an empty one when there is no pool
+static std::vector<std::pair<uint32_t,uint32_t>> borrow(RelationPool *buffers, size_t expected) {
+    if(buffers == nullptr) return {};
+    return buffers->buffer(expected);
+}
+
+static void giveBack(RelationPool *buffers, std::vector<std::pair<uint32_t,uint32_t>> &buffer) {
+    if(buffers != nullptr) buffers->recycle(std::move(buffer));
+}
+
+// The merge kernel gallops into right once per left tuple, a binary search over log2(right) tuples that
+// misses the cache when the keys of consecutive sources are far apart, and sorts the inputs that are
+// not sorted yet. The hash kernel makes a few sequential passes over both inputs whatever their order.
+// Merging wins when left is small next to right; both kernels sort or deduplicate the same raw output.
+JoinKernels::kernel JoinKernels::choose(bool leftSorted, bool rightSorted, size_t leftSize, size_t rightSize) {
+
+    uint64_t searchDepth = 1;
+    while((rightSize >> searchDepth) != 0) searchDepth ++;
+
+    uint64_t mergeCost = gallopCost * leftSize * searchDepth;
+    if(!leftSorted) mergeCost += leftSize;
+    if(!rightSorted) mergeCost += rightSize;
+
+    uint64_t hashCost = leftSize + rightSize;
+    return mergeCost < hashCost ? MERGE : HASH;
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> JoinKernels::join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    if(left->empty() || right->empty()) {
+        return RelationPool::relation(buffers, 0);
+    }
+
+    bool leftSorted = std::is_sorted(left->begin(), left->end());
+    bool rightSorted = std::is_sorted(right->begin(), right->end());
+
+    if(choose(leftSorted, rightSorted, left->size(), right->size()) == HASH)
+        return hashJoin(*left, *right, pool, stats, buffers);
+
+    uint64_t start = stats != nullptr ? kernelStats::now() : 0;
+    if(!leftSorted) radixSort(*left, buffers);
+    if(!rightSorted) radixSort(*right, buffers);
+    if(stats != nullptr) stats->sortNanos += kernelStats::now() - start;
+
+    return mergeJoin(*left, *right, pool, stats, buffers);
+}
+
+// Both inputs sorted on (first, second). The join keys of one left source are ascending, so they
+// are merged against right with a galloping search and the output comes out grouped by source;
+// duplicates only need to be removed within the group of one source.
+// With a pool, left is range-partitioned on source and the sorted runs of the partitions are
+// concatenated, which keeps the output sorted without a global re-sort.
+// The size of the output is not known up front, a pooled output starts at the size of left.
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> JoinKernels::mergeJoin(const std::vector<std::pair<uint32_t,uint32_t>> &left, const std::vector<std::pair<uint32_t,uint32_t>> &right, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    auto out = RelationPool::relation(buffers, left.size());
+
+    if(pool == nullptr || left.size() < parallelThreshold) {
+        mergeJoinRange(left, 0, left.size(), right, *out, stats);
+        return out;
+    }
+
+    auto bounds = groupBounds(left, 4 * pool->size());
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> runs(bounds.size() - 1);
+    std::vector<kernelStats> partStats(runs.size());
+    pool->parallelFor((uint32_t) runs.size(), [&](uint32_t part) {
+        mergeJoinRange(left, bounds[part], bounds[part + 1], right, runs[part], stats != nullptr ? &partStats[part] : nullptr);
+    });
+
+    concat(runs, *out);
+    if(stats != nullptr)
+        for(auto &part : partStats)
+            stats->add(part);
+    return out;
+}
+
+// the first position of right with first >= key, galloping from the position of the previous key:
+// forward while the keys of a source ascend, backward when the next source starts lower
+static size_t gallop(const std::vector<std::pair<uint32_t,uint32_t>> &right, size_t from, uint32_t key) {
+
+    auto below = [](const std::pair<uint32_t,uint32_t> &a, uint32_t k) { return a.first < k; };
+
+    size_t lo = from, hi = from;
+    size_t step = 1;
+    if(from < right.size() && right[from].first < key) {
+        while(hi < right.size() && right[hi].first < key) {
+            lo = hi;
+            hi = std::min(right.size(), hi + step);
+            step *= 2;
+        }
+    } else {
+        while(lo > 0 && right[lo - 1].first >= key) {
+            hi = lo;
+            lo = lo > step ? lo - step : 0;
+            step *= 2;
+        }
+    }
+
+    return (size_t) (std::lower_bound(right.begin() + lo, right.begin() + hi, key, below) - right.begin());
+}
+
+void JoinKernels::mergeJoinRange(const std::vector<std::pair<uint32_t,uint32_t>> &left, size_t begin, size_t end, const std::vector<std::pair<uint32_t,uint32_t>> &right, std::vector<std::pair<uint32_t,uint32_t>> &out, kernelStats *stats) {
+
+    std::vector<uint32_t> targets;
+    size_t j = 0;
+    for(size_t i = begin; i < end; ) {
+        uint32_t source = left[i].first;
+
+        targets.clear();
+        for(; i < end && left[i].first == source; i ++) {
+            uint32_t key = left[i].second;
+            j = gallop(right, j, key);
+
+            for(size_t r = j; r < right.size() && right[r].first == key; r ++)
+                targets.push_back(right[r].second);
+        }
+
+        uint64_t start = stats != nullptr ? kernelStats::now() : 0;
+        std::sort(targets.begin(), targets.end());
+        auto last = std::unique(targets.begin(), targets.end());
+        if(stats != nullptr) {
+            stats->sortNanos += kernelStats::now() - start;
+            stats->rawTuples += targets.size();
+        }
+
+        for(auto t = targets.begin(); t != last; t ++)
+            out.emplace_back(source, *t);
+    }
+}
+
+// split a relation sorted on source into at most parts ranges that do not cut the group of a source
+std::vector<size_t> JoinKernels::groupBounds(const std::vector<std::pair<uint32_t,uint32_t>> &relation, uint32_t parts) {
+
+    std::vector<size_t> bounds(1, 0);
+    for(uint32_t p = 1; p < parts; p ++) {
+        size_t split = relation.size() * p / parts;
+        while(split > bounds.back() && split < relation.size() && relation[split].first == relation[split - 1].first) split ++;
+        if(split > bounds.back() && split < relation.size()) bounds.push_back(split);
+    }
+    bounds.push_back(relation.size());
+
+    return bounds;
+}
+
+// append the runs in order, each run is moved out
+void JoinKernels::concat(std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &runs, std::vector<std::pair<uint32_t,uint32_t>> &out) {
+
+    size_t total = out.size();
+    for(const auto &run : runs)
+        total += run.size();
+    out.reserve(total);
+
+    for(auto &run : runs) {
+        out.insert(out.end(), run.begin(), run.end());
+        std::vector<std::pair<uint32_t,uint32_t>>().swap(run);
+    }
+}
+
+static inline uint32_t partitionOf(uint32_t key, uint32_t bits) {
+    return bits == 0 ? 0 : (key * 2654435769u) >> (32 - bits);
+}
+
+// scatter the relation into 2^bits partitions on the hash of first (or second) element
+static void partition(const std::vector<std::pair<uint32_t,uint32_t>> &in, bool onSecond, uint32_t bits,
+                      std::vector<std::pair<uint32_t,uint32_t>> &out, std::vector<size_t> &bounds) {
+
+    uint32_t noPartitions = 1u << bits;
+    bounds.assign(noPartitions + 1, 0);
+
+    for(const auto &tuple : in)
+        bounds[partitionOf(onSecond ? tuple.second : tuple.first, bits) + 1]++;
+    for(uint32_t p = 0; p < noPartitions; p ++)
+        bounds[p + 1] += bounds[p];
+
+    out.resize(in.size());
+    std::vector<size_t> fill(bounds.begin(), bounds.end() - 1);
+    for(const auto &tuple : in)
+        out[fill[partitionOf(onSecond ? tuple.second : tuple.first, bits)]++] = tuple;
+}
+
+// Radix-partitioned hash join for unsorted inputs: both sides are partitioned on the join key,
+// and every partition is joined with a chained hash table over its (cache-sized) right side.
+// With a pool the partitions are joined concurrently.
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> JoinKernels::hashJoin(const std::vector<std::pair<uint32_t,uint32_t>> &left, const std::vector<std::pair<uint32_t,uint32_t>> &right, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    auto out = RelationPool::relation(buffers, left.size());
+
+    uint32_t bits = 0;
+    while(bits < 16 && (right.size() >> bits) > partitionTuples) bits ++;
+
+    auto leftParts = borrow(buffers, left.size());
+    auto rightParts = borrow(buffers, right.size());
+    std::vector<size_t> leftBounds, rightBounds;
+    partition(left, true, bits, leftParts, leftBounds);
+    partition(right, false, bits, rightParts, rightBounds);
+
+    uint32_t noPartitions = 1u << bits;
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> runs(noPartitions);
+
+    auto joinPartition = [&](uint32_t p) {
+        size_t rightBegin = rightBounds[p];
+        auto rightSize = (uint32_t) (rightBounds[p + 1] - rightBegin);
+        if(rightSize == 0 || leftBounds[p] == leftBounds[p + 1]) return;
+
+        uint32_t tableBits = 1;
+        while((1u << tableBits) < 2 * rightSize) tableBits ++;
+        uint32_t mask = (1u << tableBits) - 1;
+
+        std::vector<uint32_t> head(mask + 1, UINT32_MAX);
+        std::vector<uint32_t> next(rightSize);
+        for(uint32_t r = 0; r < rightSize; r ++) {
+            uint32_t slot = (rightParts[rightBegin + r].first * 0x85EBCA6Bu) & mask;
+            next[r] = head[slot];
+            head[slot] = r;
+        }
+
+        for(size_t l = leftBounds[p]; l < leftBounds[p + 1]; l ++) {
+            uint32_t key = leftParts[l].second;
+            for(uint32_t r = head[(key * 0x85EBCA6Bu) & mask]; r != UINT32_MAX; r = next[r]) {
+                if(rightParts[rightBegin + r].first == key)
+                    runs[p].emplace_back(leftParts[l].first, rightParts[rightBegin + r].second);
+            }
+        }
+    };
+
+    if(pool != nullptr && left.size() >= parallelThreshold)
+        pool->parallelFor(noPartitions, joinPartition);
+    else
+        for(uint32_t p = 0; p < noPartitions; p ++)
+            joinPartition(p);
+
+    concat(runs, *out);
+    giveBack(buffers, leftParts);
+    giveBack(buffers, rightParts);
+
+    uint64_t start = stats != nullptr ? kernelStats::now() : 0;
+    if(stats != nullptr) stats->rawTuples += out->size();
+    sortUnique(*out, buffers);
+    if(stats != nullptr) stats->sortNanos += kernelStats::now() - start;
+
+    return out;
+}
+
+// LSD radix sort on (first, second) with 16-bit digits, skipping digits that are the same everywhere
+void JoinKernels::radixSort(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers) {
+
+    if(relation.size() < 256) {
+        std::sort(relation.begin(), relation.end());
+        return;
+    }
+
+    auto buffer = borrow(buffers, relation.size());
+    buffer.resize(relation.size());
+    std::vector<size_t> counts(1 << 16);
+
+    for(uint32_t pass = 0; pass < 4; pass ++) {
+        bool onFirst = pass >= 2;
+        uint32_t shift = (pass % 2) * 16;
+        auto digit = [&](const std::pair<uint32_t,uint32_t> &tuple) {
+            return ((onFirst ? tuple.first : tuple.second) >> shift) & 0xFFFF;
+        };
+
+        std::fill(counts.begin(), counts.end(), 0);
+        for(const auto &tuple : relation)
+            counts[digit(tuple)]++;
+        if(counts[digit(relation.front())] == relation.size()) continue;
+
+        size_t sum = 0;
+        for(auto &count : counts) {
+            size_t c = count;
+            count = sum;
+            sum += c;
+        }
+
+        for(const auto &tuple : relation)
+            buffer[counts[digit(tuple)]++] = tuple;
+        relation.swap(buffer);
+    }
+    giveBack(buffers, buffer);
+}
+
+void JoinKernels::sortUnique(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers) {
+    radixSort(relation, buffers);
+    relation.erase(std::unique(relation.begin(), relation.end()), relation.end());
+}
+
+// sort the relation unless it already is
+void JoinKernels::sorted(std::vector<std::pair<uint32_t,uint32_t>> &relation, RelationPool *buffers) {
+    if(!std::is_sorted(relation.begin(), relation.end())) radixSort(relation, buffers);
+}
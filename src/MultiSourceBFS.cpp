@@ -0,0 +1,134 @@
+#include "MultiSourceBFS.h"
+#include "SimpleEvaluator.h"
+
+MultiSourceBFS::MultiSourceBFS(std::shared_ptr<SimpleGraph> &g) {
+    graph = g;
+    acc.assign(graph->getNoVertices(), 0);
+}
+
+// one hop over a label: the masks of all frontier vertices are OR-ed into their neighbours
+MultiSourceBFS::frontier MultiSourceBFS::step(const frontier &in, uint32_t label, bool inverse) {
+
+    frontier out;
+    if(label >= graph->fwd.size()) return out;
+
+    const auto &index = inverse ? graph->rev[label] : graph->fwd[label];
+
+    touched.clear();
+    for(const auto &entry : in) {
+        index.forEach(entry.first, [&](uint32_t n) {
+            if(acc[n] == 0) touched.push_back(n);
+            acc[n] |= entry.second;
+        });
+    }
+
+    std::sort(touched.begin(), touched.end());
+    out.reserve(touched.size());
+    for(auto v : touched) {
+        out.emplace_back(v, acc[v]);
+        acc[v] = 0;
+    }
+
+    return out;
+}
+
+MultiSourceBFS::frontier MultiSourceBFS::advance(RPQTree *q, const frontier &in) {
+
+    if(in.empty()) return in;
+
+    if(q->isLeaf()) {
+        uint32_t label;
+        bool inverse;
+        if(!SimpleEvaluator::parseLabel(q->data, label, inverse)) return {};
+        return step(in, label, inverse);
+    }
+
+    else if(q->isConcat()) {
+        return advance(q->right, advance(q->left, in));
+    }
+
+    else if(q->isClosure()) {
+
+        uint32_t min, max;
+        q->closureBounds(min, max);
+
+        frontier current = in;
+        for(uint32_t k = 0; k < min && !current.empty(); k ++)
+            current = advance(q->left, current);
+
+        // only the (vertex, source) pairs that are new in a round are expanded in the next one
+        frontier result = current;
+        frontier delta = current;
+        for(uint32_t k = min; k < max && !delta.empty(); k ++) {
+            delta = subtract(advance(q->left, delta), result);
+            result = unite(result, delta);
+        }
+
+        return result;
+    }
+
+    return {};
+}
+
+MultiSourceBFS::frontier MultiSourceBFS::unite(const frontier &a, const frontier &b) {
+
+    frontier out;
+    out.reserve(a.size() + b.size());
+
+    size_t i = 0, j = 0;
+    while(i < a.size() || j < b.size()) {
+        if(j == b.size() || (i < a.size() && a[i].first < b[j].first)) out.push_back(a[i++]);
+        else if(i == a.size() || b[j].first < a[i].first) out.push_back(b[j++]);
+        else {
+            out.emplace_back(a[i].first, a[i].second | b[j].second);
+            i++;
+            j++;
+        }
+    }
+
+    return out;
+}
+
+MultiSourceBFS::frontier MultiSourceBFS::subtract(const frontier &a, const frontier &b) {
+
+    frontier out;
+    out.reserve(a.size());
+
+    size_t j = 0;
+    for(const auto &entry : a) {
+        while(j < b.size() && b[j].first < entry.first) j++;
+        uint64_t mask = entry.second;
+        if(j < b.size() && b[j].first == entry.first) mask &= ~b[j].second;
+        if(mask != 0) out.emplace_back(entry.first, mask);
+    }
+
+    return out;
+}
+
+// exact cardinalities of q over all sources, batch by batch
+cardStat MultiSourceBFS::count(RPQTree *q) {
+
+    cardStat stats {0, 0, 0};
+    std::vector<bool> reachedAny(graph->getNoVertices(), false);
+
+    frontier sources;
+    for(uint32_t base = 0; base < graph->getNoVertices(); base += batchSize) {
+
+        sources.clear();
+        for(uint32_t b = 0; b < batchSize && base + b < graph->getNoVertices(); b ++)
+            sources.emplace_back(base + b, 1ull << b);
+
+        uint64_t batchSources = 0;
+        for(const auto &entry : advance(q, sources)) {
+            batchSources |= entry.second;
+            stats.noPaths += (uint32_t) __builtin_popcountll(entry.second);
+            if(!reachedAny[entry.first]) {
+                reachedAny[entry.first] = true;
+                stats.noIn++;
+            }
+        }
+        stats.noOut += (uint32_t) __builtin_popcountll(batchSources);
+    }
+
+    return stats;
+}
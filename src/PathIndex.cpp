@@ -0,0 +1,156 @@
+#include <chrono>
+#include "PathIndex.h"
+#include "SimpleEstimator.h"
+
+static const std::regex pairPat (R"((\d+)([\+\-])/(\d+)([\+\-]))");
+
+bool PathIndex::isPair(const std::string &text) {
+    return std::regex_match(text, pairPat);
+}
+
+// the neighbours of v are every vertex two steps away over the path, sorted and without duplicates
+void PathIndex::buildPath(SimpleGraph &g, const std::string &text, CSRIndex &out) {
+
+    std::smatch matches;
+    std::regex_match(text, matches, pairPat);
+
+    auto first = (uint32_t) std::stoul(matches[1]);
+    auto second = (uint32_t) std::stoul(matches[3]);
+    const auto &firstIndex = matches[2] == "-" ? g.rev[first] : g.fwd[first];
+    const auto &secondIndex = matches[4] == "-" ? g.rev[second] : g.fwd[second];
+
+    uint32_t n = g.getNoVertices();
+    out.ownedOffsets.assign(n + 1, 0);
+    out.ownedNeighbours.clear();
+
+    uint32_t nonEmpty = 0;
+    std::vector<uint32_t> targets;
+    for(uint32_t v = 0; v < n; v ++) {
+        out.ownedOffsets[v] = (uint32_t) out.ownedNeighbours.size();
+
+        targets.clear();
+        firstIndex.forEach(v, [&](uint32_t m) { secondIndex.appendTo(m, targets); });
+        if(targets.empty()) continue;
+
+        std::sort(targets.begin(), targets.end());
+        out.ownedNeighbours.insert(out.ownedNeighbours.end(), targets.begin(), std::unique(targets.begin(), targets.end()));
+        nonEmpty++;
+    }
+    out.ownedOffsets[n] = (uint32_t) out.ownedNeighbours.size();
+    out.ownedNeighbours.shrink_to_fit();
+
+    out.view(n, out.ownedOffsets[n], nonEmpty, out.ownedOffsets.data(), out.ownedNeighbours.data());
+}
+
+// the label statistics of both steps of a path, and the estimated pairs of the path itself
+cardStat PathIndex::estimate(SimpleGraph &g, uint32_t a, bool inverseA, uint32_t b, bool inverseB, std::vector<cardStat> &atoms) {
+
+    const auto &outA = inverseA ? g.rev[a] : g.fwd[a];
+    const auto &inA = inverseA ? g.fwd[a] : g.rev[a];
+    const auto &outB = inverseB ? g.rev[b] : g.fwd[b];
+    const auto &inB = inverseB ? g.fwd[b] : g.rev[b];
+
+    atoms = {{outA.noNonEmpty, outA.size(), inA.noNonEmpty},
+             {outB.noNonEmpty, outB.size(), inB.noNonEmpty}};
+    return SimpleEstimator::chain(atoms);
+}
+
+// every pair of labels and directions, the ones that save the most join work per stored pair first:
+// joining the labels produces about a.noPaths * b.noPaths / |join keys| pairs before deduplication
+std::vector<std::string> PathIndex::choose(SimpleGraph &g) {
+
+    std::vector<std::pair<double, std::string>> candidates;
+    std::vector<cardStat> atoms;
+
+    for(uint32_t a = 0; a < g.getNoLabels(); a ++) {
+        for(uint32_t b = 0; b < g.getNoLabels(); b ++) {
+            for(int directions = 0; directions < 4; directions ++) {
+                bool inverseA = (directions & 1) != 0;
+                bool inverseB = (directions & 2) != 0;
+
+                auto path = estimate(g, a, inverseA, b, inverseB, atoms);
+                if(path.noPaths == 0) continue;
+
+                double raw = (double) atoms[0].noPaths * atoms[1].noPaths / std::max({1u, atoms[0].noIn, atoms[1].noOut});
+                std::string text = std::to_string(a) + (inverseA ? "-" : "+") + "/" + std::to_string(b) + (inverseB ? "-" : "+");
+                candidates.emplace_back(raw / path.noPaths, text);
+            }
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<double, std::string> &x, const std::pair<double, std::string> &y) {
+        return x.first > y.first;
+    });
+
+    std::vector<std::string> texts;
+    for(auto &candidate : candidates)
+        texts.push_back(candidate.second);
+    return texts;
+}
+
+// Build the given paths in order, or the chosen ones if none are given, within the budget (in bytes).
+// A path whose estimated size does not fit in what is left is skipped without building it; once a
+// built path turns out not to fit after all, the estimates are not to be trusted and building stops.
+void PathIndex::build(SimpleGraph &g, const std::vector<std::string> &frequent, size_t budget) {
+
+    auto start = std::chrono::steady_clock::now();
+    clear();
+
+    auto texts = frequent.empty() ? choose(g) : frequent;
+    size_t offsetBytes = sizeof(uint32_t) * ((size_t) g.getNoVertices() + 1);
+    std::vector<cardStat> atoms;
+
+    for(auto &text : texts) {
+        if(bytes + offsetBytes > budget) break;
+
+        std::smatch matches;
+        if(!std::regex_match(text, matches, pairPat) || paths.count(text) > 0) continue;
+        auto a = std::stoul(matches[1]);
+        auto b = std::stoul(matches[3]);
+        if(a >= g.getNoLabels() || b >= g.getNoLabels()) continue;
+
+        auto expected = estimate(g, (uint32_t) a, matches[2] == "-", (uint32_t) b, matches[4] == "-", atoms);
+        if(bytes + offsetBytes + sizeof(uint32_t) * (size_t) expected.noPaths > budget) continue;
+
+        CSRIndex path;
+        buildPath(g, text, path);
+
+        size_t size = offsetBytes + sizeof(uint32_t) * path.size();
+        if(bytes + size > budget) break;
+
+        bytes += size;
+        paths.emplace(text, std::move(path));
+    }
+
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PathIndex::clear() {
+    paths.clear();
+    bytes = 0;
+}
+
+// the index of a concatenation of two labels, if it was built
+const CSRIndex *PathIndex::find(RPQTree *q) const {
+
+    if(paths.empty() || !q->isConcat() || !q->left->isLeaf() || !q->right->isLeaf()) return nullptr;
+    return find(q->left->data + "/" + q->right->data);
+}
+
+const CSRIndex *PathIndex::find(const std::string &text) const {
+
+    auto it = paths.find(text);
+    return it == paths.end() ? nullptr : &it->second;
+}
+
+size_t PathIndex::size() const {
+    return paths.size();
+}
+
+size_t PathIndex::getBytes() const {
+    return bytes;
+}
+
+double PathIndex::getBuildTime() const {
+    return buildTime;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include "Pipeline.h"
+#include "SimpleEvaluator.h"
+
+Pipeline::Pipeline(std::shared_ptr<SimpleGraph> &g) {
+    graph = g;
+}
+
+// the labels of a concatenation from left to right, false for anything else
+bool Pipeline::chain(RPQTree *q, std::vector<std::pair<uint32_t,bool>> &labels) {
+
+    if(q->isLeaf()) {
+        uint32_t label;
+        bool inverse;
+        if(!SimpleEvaluator::parseLabel(q->data, label, inverse)) return false;
+        labels.emplace_back(label, inverse);
+        return true;
+    }
+
+    if(q->isConcat()) return chain(q->left, labels) && chain(q->right, labels);
+
+    return false;
+}
+
+bool Pipeline::supports(RPQTree *q) {
+    std::vector<std::pair<uint32_t,bool>> labels;
+    return chain(q, labels);
+}
+
+// a pair out of stage i: counted if it leaves the last stage, queued for the next one otherwise
+void Pipeline::emit(size_t i, uint32_t source, uint32_t target) {
+
+    rawPairs++;
+
+    if(i + 1 == stages.size()) {
+        if(source != sinkSource) {
+            if(sinkSource != UINT32_MAX) sink->endSource();
+            sink->beginSource(source);
+            sinkSource = source;
+        }
+        sink->add(target);
+        return;
+    }
+
+    auto &current = stages[i];
+    if(current.seen[target] == source + 1) return;
+    current.seen[target] = source + 1;
+
+    size_t capacity = current.batch.capacity();
+    current.batch.emplace_back(source, target);
+    if(current.batch.capacity() != capacity) hold((current.batch.capacity() - capacity) * sizeof(std::pair<uint32_t,uint32_t>));
+    if(current.batch.size() == batchSize) flush(i);
+}
+
+// the queued pairs of stage i through the index of stage i + 1, in the order they were queued
+void Pipeline::flush(size_t i) {
+
+    auto &current = stages[i];
+    const CSRIndex &next = *stages[i + 1].index;
+    for(const auto &pair : current.batch)
+        next.forEach(pair.second, [&](uint32_t n) { emit(i + 1, pair.first, n); });
+    current.batch.clear();
+}
+
+// count bytes the pipeline now holds on top of what it held, and keep the largest total
+void Pipeline::hold(uint64_t bytes) {
+    liveBytes += bytes;
+    peakBytes = std::max(peakBytes, liveBytes);
+}
+
+cardStat Pipeline::count(RPQTree *q, bool backward, RelationPool *buffers) {
+
+    rawPairs = 0;
+    liveBytes = 0;
+    peakBytes = 0;
+
+    std::vector<std::pair<uint32_t,bool>> labels;
+    if(!chain(q, labels)) return {0, 0, 0};
+
+    // the inverse chain from the targets has the same pairs, reversed
+    if(backward) {
+        std::reverse(labels.begin(), labels.end());
+        for(auto &label : labels) label.second = !label.second;
+    }
+
+    uint32_t noVertices = graph->getNoVertices();
+    stages.assign(labels.size(), stage());
+    for(size_t i = 0; i < labels.size(); i++) {
+        if(labels[i].first >= graph->fwd.size()) return {0, 0, 0};
+        stages[i].index = labels[i].second ? &graph->rev[labels[i].first] : &graph->fwd[labels[i].first];
+        if(i + 1 == labels.size()) continue;
+
+        if(buffers != nullptr) stages[i].seen = buffers->array(noVertices);
+        stages[i].seen.assign(noVertices, 0);
+        hold(stages[i].seen.capacity() * sizeof(uint32_t));
+    }
+
+    cardCounter counter(noVertices, buffers);
+    hold((counter.stamp.data.capacity() + counter.reachedAny.data.capacity()) * sizeof(uint32_t));
+    sink = &counter;
+    sinkSource = UINT32_MAX;
+
+    stages.front().index->scan(0, noVertices, [&](uint32_t v, uint32_t n) { emit(0, v, n); });
+    for(size_t i = 0; i + 1 < stages.size(); i++) flush(i);
+    if(sinkSource != UINT32_MAX) counter.endSource();
+
+    if(buffers != nullptr)
+        for(auto &current : stages) buffers->recycle(std::move(current.seen));
+    stages.clear();
+    sink = nullptr;
+
+    cardStat stats = counter.stats;
+    if(backward) std::swap(stats.noOut, stats.noIn);
+    return stats;
+}
+
+uint64_t Pipeline::getRawPairs() const {
+    return rawPairs;
+}
+
+uint64_t Pipeline::getPeakBytes() const {
+    return peakBytes;
+}
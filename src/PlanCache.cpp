@@ -0,0 +1,84 @@
+#include "PlanCache.h"
+
+PlanCache::PlanCache(size_t capacity) : capacity(capacity), version(0), hits(0), misses(0), planningNanos(0) {}
+
+// drop every entry planned against another version of the graph or statistics
+void PlanCache::reset(uint64_t newVersion) {
+    entries.clear();
+    lookup.clear();
+    version = newVersion;
+}
+
+bool PlanCache::get(const std::string &key, uint64_t currentVersion, std::vector<uint32_t> &order) {
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(currentVersion != version) reset(currentVersion);
+
+    auto it = lookup.find(key);
+    if(it == lookup.end()) {
+        misses++;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    order = it->second->second;
+    hits++;
+    return true;
+}
+
+void PlanCache::put(const std::string &key, uint64_t currentVersion, std::vector<uint32_t> order, uint64_t nanos) {
+
+    planningNanos += nanos;
+    if(capacity == 0) return;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(currentVersion != version) reset(currentVersion);
+
+    // another thread may have planned the same query in the meantime
+    auto it = lookup.find(key);
+    if(it != lookup.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+
+    entries.emplace_front(key, std::move(order));
+    lookup[key] = entries.begin();
+
+    if(entries.size() > capacity) {
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void PlanCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    reset(version);
+}
+
+uint64_t PlanCache::getHits() const {
+    return hits;
+}
+
+uint64_t PlanCache::getMisses() const {
+    return misses;
+}
+
+// milliseconds spent planning queries that were not in the cache
+double PlanCache::getPlanningTime() const {
+    return planningNanos / 1e6;
+}
+
+// text of the query without spaces or redundant parentheses: concatenation is associative, so
+// every way of grouping the same chain maps to the same key
+std::string PlanCache::canonical(RPQTree *q) {
+
+    if(q->isConcat())
+        return canonical(q->left) + "/" + canonical(q->right);
+
+    if(q->isClosure()) {
+        if(q->left->isLeaf()) return q->left->data + q->data;
+        return "(" + canonical(q->left) + ")" + q->data;
+    }
+
+    return q->data;
+}
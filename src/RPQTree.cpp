@@ -3,6 +3,7 @@
 //
 
 #include <iostream>
+#include <regex>
 #include "RPQTree.h"
 
 RPQTree::~RPQTree() {
@@ -10,6 +11,39 @@ RPQTree::~RPQTree() {
     delete(right);
 }
 
+// a single label such as 12+ or 3-
+static bool isLabel(const std::string &str) {
+    if(str.size() < 2 || (str.back() != '+' && str.back() != '-')) return false;
+    return std::all_of(str.begin(), str.end() - 1, ::isdigit);
+}
+
+// a repetition count below UNBOUNDED, false if the digits do not fit
+static bool parseCount(const std::string &digits, uint32_t &count) {
+    uint64_t value = 0;
+    for(char c : digits) {
+        value = value * 10 + (uint64_t) (c - '0');
+        if(value >= UNBOUNDED) return false;
+    }
+    count = (uint32_t) value;
+    return true;
+}
+
+static const std::regex boundsPat (R"(\{(\d+)(,(\d*))?\})");
+
+// normalise '{m}', '{m,}' and '{m,n}' in place to '{m,n}' or '{m,}', false if malformed or out of range
+static bool parseBounds(std::string &payload) {
+    std::smatch matches;
+    if(!std::regex_match(payload, matches, boundsPat)) return false;
+
+    std::string upper = matches[2].matched ? std::string(matches[3]) : std::string(matches[1]);
+    uint32_t min, max;
+    if(!parseCount(matches[1], min)) return false;
+    if(!upper.empty() && (!parseCount(upper, max) || max < min)) return false;
+
+    payload = "{" + std::to_string(min) + "," + (upper.empty() ? std::string() : std::to_string(max)) + "}";
+    return true;
+}
+
 RPQTree* RPQTree::strToTree(std::string &str) {
 
     str.erase(std::remove_if(str.begin(), str.end(), ::isspace), str.end()); // remove spaces
@@ -37,6 +71,40 @@ RPQTree* RPQTree::strToTree(std::string &str) {
         }
     }
 
+    if(str.empty()) {
+        std::cerr << "Error: parsing RPQ failed." << std::endl;
+        return nullptr;
+    }
+
+    // case label
+    if(isLabel(str))
+        return new RPQTree(str, nullptr, nullptr);
+
+    // case closure
+    // postfix '*', '+' or '{m,n}' applied to everything before it; the operand is parsed first so a
+    // closure of nothing fails instead of becoming a childless node
+    if(str.back() == '*' || str.back() == '+') {
+        std::string exp(str.substr(0, str.size() - 1));
+        std::string payload(1, str.back());
+        RPQTree *operand = strToTree(exp);
+        if(operand == nullptr) return nullptr;
+        return new RPQTree(payload, operand, nullptr);
+    }
+    if(str.back() == '}') {
+        auto open = str.rfind('{');
+        if(open != std::string::npos && open > 0) {
+            std::string exp(str.substr(0, open));
+            std::string payload(str.substr(open));
+            if(parseBounds(payload)) {
+                RPQTree *operand = strToTree(exp);
+                if(operand == nullptr) return nullptr;
+                return new RPQTree(payload, operand, nullptr);
+            }
+        }
+        std::cerr << "Error: parsing RPQ failed." << std::endl;
+        return nullptr;
+    }
+
     if(str[0]=='('){
         //case ()
         //pull out inside and to strToTree
@@ -79,6 +147,26 @@ bool RPQTree::isConcat() {
     return (data == "/") && isBinary();
 }
 
+bool RPQTree::isClosure() {
+    return isUnary() && (data == "*" || data == "+" || data.front() == '{');
+}
+
+// number of repetitions allowed by a closure, max is UNBOUNDED for '*', '+' and '{m,}'
+void RPQTree::closureBounds(uint32_t &min, uint32_t &max) {
+    if(data == "*") {
+        min = 0;
+        max = UNBOUNDED;
+    } else if(data == "+") {
+        min = 1;
+        max = UNBOUNDED;
+    } else {
+        auto comma = data.find(',');
+        min = (uint32_t) std::stoul(data.substr(1, comma - 1));
+        auto upper = data.substr(comma + 1, data.size() - comma - 2);
+        max = upper.empty() ? UNBOUNDED : (uint32_t) std::stoul(upper);
+    }
+}
+
 bool RPQTree::isBinary() {
     return left != nullptr && right != nullptr;
 }
@@ -0,0 +1,119 @@
+#include "RelationPool.h"
+
+RelationPool::RelationPool(size_t budget) : budget(budget), reused(0), allocated(0), dropped(0) {}
+
+// the smallest free buffer that holds expected elements, or a new one reserved for them. A buffer
+// much larger than asked for is left for a larger request, the relation may end up in the result
+// cache, which charges its capacity.
+template<typename T>
+std::vector<T> RelationPool::take(freeList<T> &list, size_t expected) {
+
+    if(expected == 0) return {};
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto fit = list.lower_bound(expected);
+        if(fit != list.end() && fit->first <= 2 * expected + slack) {
+            std::vector<T> buffer = std::move(fit->second);
+            used -= fit->first * sizeof(T);
+            list.erase(fit);
+            reused++;
+            return buffer;
+        }
+    }
+
+    allocated++;
+    std::vector<T> buffer;
+    buffer.reserve(expected);
+    return buffer;
+}
+
+template<typename T>
+void RelationPool::give(freeList<T> &list, std::vector<T> &&buffer) {
+
+    size_t size = buffer.capacity() * sizeof(T);
+    if(size == 0) return;
+
+    buffer.clear();
+    std::lock_guard<std::mutex> guard(lock);
+    if(used + size > budget) {
+        dropped++;
+        return;
+    }
+
+    used += size;
+    list.emplace(buffer.capacity(), std::move(buffer));
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> RelationPool::relation(size_t expected) {
+
+    std::weak_ptr<RelationPool> owner = shared_from_this();
+    auto data = new std::vector<std::pair<uint32_t,uint32_t>>(buffer(expected));
+
+    return std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>>(data, [owner](std::vector<std::pair<uint32_t,uint32_t>> *data) {
+        if(auto pool = owner.lock()) pool->recycle(std::move(*data));
+        delete data;
+    });
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> RelationPool::relation(RelationPool *pool, size_t expected) {
+
+    if(pool != nullptr) return pool->relation(expected);
+    return std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
+}
+
+std::vector<std::pair<uint32_t,uint32_t>> RelationPool::buffer(size_t expected) {
+    return take(relations, expected);
+}
+
+void RelationPool::recycle(std::vector<std::pair<uint32_t,uint32_t>> &&buffer) {
+    give(relations, std::move(buffer));
+}
+
+std::vector<uint32_t> RelationPool::array(size_t expected) {
+    return take(arrays, expected);
+}
+
+void RelationPool::recycle(std::vector<uint32_t> &&array) {
+    give(arrays, std::move(array));
+}
+
+void RelationPool::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    relations.clear();
+    arrays.clear();
+    used = 0;
+}
+
+RelationPool::scratch::scratch(RelationPool *owner, size_t size) : owner(owner) {
+    reset(size);
+}
+
+void RelationPool::scratch::reset(size_t size) {
+    if(owner != nullptr && data.capacity() < size) {
+        owner->recycle(std::move(data));
+        data = owner->array(size);
+    }
+    data.assign(size, 0);
+}
+
+RelationPool::scratch::~scratch() {
+    if(owner != nullptr) owner->recycle(std::move(data));
+}
+
+uint64_t RelationPool::getReused() const {
+    return reused;
+}
+
+uint64_t RelationPool::getAllocated() const {
+    return allocated;
+}
+
+uint64_t RelationPool::getDropped() const {
+    return dropped;
+}
+
+size_t RelationPool::getBytesPooled() {
+    std::lock_guard<std::mutex> guard(lock);
+    return used;
+}
@@ -0,0 +1,89 @@
+#include "ResultCache.h"
+
+ResultCache::ResultCache(size_t budget) : budget(budget), used(0), version(0), hits(0), misses(0), evictions(0) {}
+
+size_t ResultCache::bytes(const entry &e) {
+    return e.first.size() + e.second->capacity() * sizeof(std::pair<uint32_t,uint32_t>);
+}
+
+// drop every relation computed on another version of the graph
+void ResultCache::reset(uint64_t newVersion) {
+    entries.clear();
+    lookup.clear();
+    used = 0;
+    version = newVersion;
+}
+
+ResultCache::relation ResultCache::get(const std::string &key, uint64_t currentVersion) {
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(currentVersion != version) reset(currentVersion);
+
+    auto it = lookup.find(key);
+    if(it == lookup.end()) {
+        misses++;
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    hits++;
+    return it->second->second;
+}
+
+// whether a relation is cached, without counting a lookup or refreshing its position
+bool ResultCache::contains(const std::string &key, uint64_t currentVersion) const {
+
+    std::lock_guard<std::mutex> guard(lock);
+    return currentVersion == version && lookup.count(key) > 0;
+}
+
+void ResultCache::put(const std::string &key, uint64_t currentVersion, relation &result) {
+
+    entry e {key, result};
+    size_t size = bytes(e);
+    if(size > budget) return;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(currentVersion != version) reset(currentVersion);
+
+    // another thread may have computed the same relation in the meantime
+    if(lookup.count(key) > 0) return;
+
+    entries.push_front(std::move(e));
+    lookup[key] = entries.begin();
+    used += size;
+
+    while(used > budget) {
+        used -= bytes(entries.back());
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+        evictions++;
+    }
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    reset(version);
+}
+
+uint64_t ResultCache::getHits() const {
+    return hits;
+}
+
+uint64_t ResultCache::getMisses() const {
+    return misses;
+}
+
+uint64_t ResultCache::getEvictions() const {
+    return evictions;
+}
+
+size_t ResultCache::getBytesUsed() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return used;
+}
+
+double ResultCache::getHitRate() const {
+    uint64_t lookups = hits + misses;
+    return lookups > 0 ? (double) hits / lookups : 0;
+}
@@ -0,0 +1,176 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include "ResultSink.h"
+
+CallbackSink::CallbackSink(callback f) : f(std::move(f)) {}
+
+void CallbackSink::consume(const std::pair<uint32_t,uint32_t> *pairs, size_t count) {
+    f(pairs, count);
+}
+
+FileSink::FileSink(const std::string &fileName, format fmt, size_t queueDepth)
+        : out(std::fopen(fileName.c_str(), "wb")), owned(true), fmt(fmt), queueDepth(queueDepth > 0 ? queueDepth : 1) {
+
+    if(out == nullptr)
+        throw std::runtime_error(std::string("Unable to open result file: ") + fileName);
+    writer = std::thread(&FileSink::work, this);
+}
+
+FileSink::FileSink(FILE *stream, format fmt, size_t queueDepth)
+        : out(stream), owned(false), fmt(fmt), queueDepth(queueDepth > 0 ? queueDepth : 1) {
+    writer = std::thread(&FileSink::work, this);
+}
+
+FileSink::~FileSink() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_one();
+    writer.join();
+
+    if(owned) std::fclose(out);
+    else std::fflush(out);
+}
+
+bool FileSink::parseFormat(const std::string &name, format &fmt) {
+    if(name == "text") fmt = TEXT;
+    else if(name == "binary") fmt = BINARY;
+    else return false;
+    return true;
+}
+
+// the pairs are copied, a sink cannot keep a buffer it is only lent
+void FileSink::consume(const std::pair<uint32_t,uint32_t> *pairs, size_t count) {
+
+    if(count == 0) return;
+
+    std::vector<std::pair<uint32_t,uint32_t>> buffer;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        check();
+        if(!spare.empty()) {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+
+    buffer.assign(pairs, pairs + count);
+    take(buffer);
+
+    std::lock_guard<std::mutex> guard(lock);
+    if(buffer.capacity() > 0) spare.push_back(std::move(buffer));
+}
+
+// the batch itself is queued and the caller is left with an empty buffer to fill next
+void FileSink::take(std::vector<std::pair<uint32_t,uint32_t>> &batch) {
+
+    if(batch.empty()) return;
+
+    std::unique_lock<std::mutex> guard(lock);
+    if(queued.size() >= queueDepth) {
+        stalls++;
+        room.wait(guard, [&]() { return queued.size() < queueDepth; });
+    }
+    check();
+
+    std::vector<std::pair<uint32_t,uint32_t>> buffer;
+    if(!spare.empty()) {
+        buffer = std::move(spare.back());
+        spare.pop_back();
+    }
+
+    queued.push_back(std::move(batch));
+    batch = std::move(buffer);
+    batch.clear();
+    ready.notify_one();
+}
+
+void FileSink::finish() {
+
+    std::unique_lock<std::mutex> guard(lock);
+    drained.wait(guard, [&]() { return queued.empty() && !writing; });
+    check();
+
+    if(std::fflush(out) != 0 || std::ferror(out)) {
+        error = std::string("Unable to write results: ") + std::strerror(errno);
+        check();
+    }
+}
+
+// throws the first failed write; called with the lock held
+void FileSink::check() {
+    if(!error.empty()) throw std::runtime_error(error);
+}
+
+// drains the queue until the sink is closed; the queued batches are written before the thread exits,
+// and dropped once a write has failed
+void FileSink::work() {
+
+    std::unique_lock<std::mutex> guard(lock);
+    while(true) {
+        ready.wait(guard, [&]() { return stopping || !queued.empty(); });
+        if(queued.empty()) return;
+
+        auto batch = std::move(queued.front());
+        queued.pop_front();
+        writing = true;
+        bool failed = !error.empty();
+        room.notify_one();
+
+        guard.unlock();
+        bool ok = failed || write(batch);
+        int reason = errno;
+        guard.lock();
+
+        if(!ok) error = std::string("Unable to write results: ") + std::strerror(reason);
+        else if(!failed) written += batch.size();
+
+        writing = false;
+        batch.clear();
+        spare.push_back(std::move(batch));
+        if(queued.empty()) drained.notify_all();
+    }
+}
+
+static char *appendNumber(char *p, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+    while(n > 0) *p++ = digits[--n];
+    return p;
+}
+
+// false if the batch could not be written in full
+bool FileSink::write(const std::vector<std::pair<uint32_t,uint32_t>> &batch) {
+
+    if(fmt == BINARY)
+        return std::fwrite(batch.data(), sizeof(std::pair<uint32_t,uint32_t>), batch.size(), out) == batch.size();
+
+    // two numbers of at most 10 digits, a space and a newline per pair
+    text.resize(batch.size() * 22);
+    char *p = text.data();
+    for(const auto &pair : batch) {
+        p = appendNumber(p, pair.first);
+        *p++ = ' ';
+        p = appendNumber(p, pair.second);
+        *p++ = '\n';
+    }
+    auto length = (size_t) (p - text.data());
+    return std::fwrite(text.data(), 1, length, out) == length;
+}
+
+uint64_t FileSink::getPairsWritten() {
+    std::lock_guard<std::mutex> guard(lock);
+    return written;
+}
+
+uint64_t FileSink::getStalls() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stalls;
+}
@@ -2,12 +2,13 @@
 // Created by Nikolay Yakovets on 2018-02-01.
 //
 
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
 #include "SimpleGraph.h"
 #include "SimpleEstimator.h"
-
-uint32_t numLabels;
-cardStat* labelData;
-std::vector<std::pair<uint32_t, char>> queryVector;
+#include "HyperLogLog.h"
 
 
 SimpleEstimator::SimpleEstimator(std::shared_ptr<SimpleGraph> &g){
@@ -18,111 +19,536 @@ SimpleEstimator::SimpleEstimator(std::shared_ptr<SimpleGraph> &g){
 
 }
 
-void SimpleEstimator::prepare() {
+// the index an atom reads: the reverse index holds the inverse label sorted by its new source
+static const CSRIndex &indexOf(SimpleGraph &g, uint32_t atom) {
+    return (atom & 1) ? g.rev[atom / 2] : g.fwd[atom / 2];
+}
 
-    numLabels = graph.get()->getNoLabels();
-    labelData = new cardStat[numLabels];
+static uint32_t bucketOf(uint32_t degree) {
+    uint32_t bucket = 0;
+    while(degree >>= 1) bucket++;
+    return bucket;
+}
 
-    uint32_t numIn;
-    uint32_t numOut;
+// heavy hitters are kept as a min-heap on degree while counting
+static bool heavier(const std::pair<uint32_t,uint32_t> &a, const std::pair<uint32_t,uint32_t> &b) {
+    return a.second > b.second;
+}
+
+// keep the k vertices with the smallest hashes, a max-heap on the hash while sampling
+static void addToSample(std::vector<uint32_t> &sample, uint32_t v, uint32_t k, uint64_t seed) {
 
-    for(auto i = 0; i < numLabels; i ++) {
-        if(graph.get()->adj[i].empty()) {
-            labelData[i] = {0, 0, 0};
+    auto before = [seed](uint32_t a, uint32_t b) { return HyperLogLog::hash(a, seed) < HyperLogLog::hash(b, seed); };
+
+    if(sample.size() < k) {
+        sample.push_back(v);
+        std::push_heap(sample.begin(), sample.end(), before);
+    } else if(before(v, sample.front())) {
+        std::pop_heap(sample.begin(), sample.end(), before);
+        sample.back() = v;
+        std::push_heap(sample.begin(), sample.end(), before);
+    }
+}
+
+// degrees of both atoms of a label, read list by list from their indexes: histograms, heavy hitters,
+// target samples and sketches, and the (vertex, degree) of every vertex with neighbours. Both atoms
+// are done together as each one samples the targets of the other.
+void SimpleEstimator::countDegrees(uint32_t label, std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &nonEmpty) {
+
+    for(uint32_t a = 2 * label; a < 2 * label + 2; a ++) {
+        const auto &index = indexOf(*graph, a);
+        auto &synopsis = atomData[a];
+        auto &heavy = synopsis.heavyHitters;
+        synopsis.histogramVertices.assign(32, 0);
+        synopsis.histogramDegrees.assign(32, 0);
+        nonEmpty[a].reserve(index.noNonEmpty);
+        if(sketchRegisters > 0) {
+            sketchVertices[a].reserve(index.noNonEmpty);
+            sketches[a].assign((size_t) index.noNonEmpty * sketchRegisters, 0);
         }
-        else {
-
-            numIn = 0;
-            numOut = 0;
-
-            std::sort(graph.get()->adj[i].begin(), graph.get()->adj[i].end(), SimpleGraph::sortPairsFirst);
-            bool first = true;
-            for (auto j = 0; j < graph.get()->adj[i].size(); j++) {
-                if (first) {
-                    numOut++;
-                    first = false;
-                } else {
-                    if (graph.get()->adj[i][j].first != graph.get()->adj[i][j - 1].first)
-                        numOut++;
-                }
+
+        index.forEachNonEmpty([&](uint32_t v, uint32_t degree) {
+            // v has out-edges for a, so it is a target of the inverse of a
+            addToSample(atomData[a ^ 1u].targetSample, v, sampleSize, sampleSeed);
+
+            if(sketchRegisters > 0) {
+                uint8_t *sketch = &sketches[a][nonEmpty[a].size() * sketchRegisters];
+                index.forEach(v, [&](uint32_t n) { HyperLogLog::add(sketch, sketchRegisters, n); });
+                sketchVertices[a].push_back(v);
             }
+            nonEmpty[a].emplace_back(v, degree);
+
+            uint32_t bucket = bucketOf(degree);
+            synopsis.histogramVertices[bucket]++;
+            synopsis.histogramDegrees[bucket] += degree;
 
-            std::sort(graph.get()->adj[i].begin(), graph.get()->adj[i].end(), SimpleGraph::sortPairsSecond);
-            first = true;
-            for (auto j = 0; j < graph.get()->adj[i].size(); j++) {
-                if (first) {
-                    numIn++;
-                    first = false;
-                } else {
-                    if (graph.get()->adj[i][j].second != graph.get()->adj[i][j - 1].second)
-                        numIn++;
-                }
+            if(heavy.size() < noHeavyHitters) {
+                heavy.emplace_back(v, degree);
+                std::push_heap(heavy.begin(), heavy.end(), heavier);
+            } else if(degree > heavy.front().second) {
+                std::pop_heap(heavy.begin(), heavy.end(), heavier);
+                heavy.back() = std::make_pair(v, degree);
+                std::push_heap(heavy.begin(), heavy.end(), heavier);
             }
+        });
 
-            labelData[i] = {numOut, graph.get()->adj[i].size(), numIn};
+        std::sort(heavy.begin(), heavy.end(), heavier);
+    }
+}
+
+// the pairs that start with atom a. A join key v is a target of a, a source of its inverse: the edges
+// of a that end in v continue over every edge of B from v. Then the sources of a that reach B from any
+// of their a-neighbours. present lists the (atom, degree) of every atom with out-edges at a vertex,
+// from start[v] to start[v + 1].
+void SimpleEstimator::countPairs(uint32_t a, const std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &nonEmpty, const std::vector<uint32_t> &start, const std::vector<std::pair<uint32_t,uint32_t>> &present, pairScratch &scratch) {
+
+    auto touch = [&](uint32_t b) -> pairSynopsis & {
+        if(!scratch.used[b]) {
+            scratch.used[b] = 1;
+            scratch.touched.push_back(b);
+        }
+        return scratch.row[b];
+    };
+
+    for(const auto &key : nonEmpty[a ^ 1u]) {
+        for(uint32_t j = start[key.first]; j < start[key.first + 1]; j ++) {
+            auto &pair = touch(present[j].first);
+            pair.joinSize += (uint64_t) key.second * present[j].second;
+            pair.noKeys++;
+            pair.keyEdges += present[j].second;
         }
     }
+
+    const auto &index = indexOf(*graph, a);
+    for(const auto &source : nonEmpty[a]) {
+        scratch.current++;
+        index.forEach(source.first, [&](uint32_t m) {
+            for(uint32_t j = start[m]; j < start[m + 1]; j ++) {
+                uint32_t b = present[j].first;
+                if(scratch.stamp[b] == scratch.current) continue;
+                scratch.stamp[b] = scratch.current;
+                touch(b).noOut++;
+            }
+        });
+    }
+
+    std::sort(scratch.touched.begin(), scratch.touched.end());
+    partners[a].reserve(scratch.touched.size());
+    for(auto b : scratch.touched) {
+        partners[a].emplace_back(b, scratch.row[b]);
+        scratch.row[b] = pairSynopsis();
+        scratch.used[b] = 0;
+    }
+    scratch.touched.clear();
+}
+
+const pairSynopsis &SimpleEstimator::pairOf(uint32_t a, uint32_t b) const {
+    static const pairSynopsis none;
+    const auto &list = partners[a];
+    auto pair = std::lower_bound(list.begin(), list.end(), b, [](const std::pair<uint32_t,pairSynopsis> &entry, uint32_t atom) { return entry.first < atom; });
+    return pair != list.end() && pair->first == b ? pair->second : none;
+}
+
+// memory the per-vertex sketches of all labels may take together, 0 for none
+void SimpleEstimator::setSketchBudget(size_t bytes) {
+    sketchBudget = bytes;
+}
+
+// the sketch of v in the atom, nullptr if v has no out-edges there; vertices are found by their rank
+const uint8_t *SimpleEstimator::sketchOf(uint32_t atom, uint32_t v) const {
+    const auto &vertices = sketchVertices[atom];
+    auto rank = std::lower_bound(vertices.begin(), vertices.end(), v);
+    if(rank == vertices.end() || *rank != v) return nullptr;
+    return &sketches[atom][(size_t) (rank - vertices.begin()) * sketchRegisters];
 }
 
-void treeToList(RPQTree* q) {
+// Two parallel passes reading the indexes only. The first one counts degrees and fills the sketches
+// one label at a time from the lists of its indexes; the atoms with out-edges at every vertex are then
+// gathered, and the second one counts the pairs that start with every atom over them. Only the pairs
+// that meet at some vertex are kept, so neither the time nor the memory grows with the square of the
+// number of labels.
+void SimpleEstimator::prepare() {
+
+    numLabels = graph.get()->getNoLabels();
+    numAtoms = 2 * numLabels;
+    uint32_t noVertices = graph->getNoVertices();
+
+    atomData.assign(numAtoms, atomSynopsis());
+    partners.assign(numAtoms, {});
+    if(numAtoms == 0) return;
+
+    // distinct sources and targets are the vertices with a non-empty neighbour list,
+    // counted when the indexes are built (or stored in the snapshot)
+    for(uint32_t a = 0; a < numAtoms; a ++) {
+        const auto &out = indexOf(*graph, a);
+        const auto &in = indexOf(*graph, a ^ 1u);
+        atomData[a].stats = {out.noNonEmpty, out.size(), in.noNonEmpty};
+    }
+
+    // the largest power of two registers per sketched vertex that fits the budget, counting its rank entry
+    size_t noSketched = 0;
+    for(uint32_t a = 0; a < numAtoms; a ++)
+        noSketched += atomData[a].stats.noOut;
+    sketchRegisters = maxRegisters;
+    while(sketchRegisters >= minRegisters && noSketched * (sketchRegisters + sizeof(uint32_t)) > sketchBudget)
+        sketchRegisters /= 2;
+    if(sketchRegisters < minRegisters) sketchRegisters = 0;
+    sketchVertices.assign(sketchRegisters > 0 ? numAtoms : 0, {});
+    sketches.assign(sketchRegisters > 0 ? numAtoms : 0, {});
+
+    auto noThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), numAtoms));
+
+    // body(thread, item) for every item in [0, noItems), claimed by the threads in turn
+    auto parallel = [&](uint32_t noItems, const std::function<void(uint32_t, uint32_t)> &body) {
+        std::atomic<uint32_t> next {0};
+        auto worker = [&](uint32_t thread) {
+            for(uint32_t item = next++; item < noItems; item = next++)
+                body(thread, item);
+        };
+
+        std::vector<std::thread> workers;
+        for(uint32_t i = 1; i < noThreads; i++)
+            workers.emplace_back(worker, i);
+        worker(0);
+        for(auto &w : workers)
+            w.join();
+    };
+
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> nonEmpty(numAtoms);
+    parallel(numLabels, [&](uint32_t, uint32_t label) {
+        countDegrees(label, nonEmpty);
+    });
+
+    // the (atom, degree) of every atom with out-edges at a vertex, by vertex and then atom
+    std::vector<uint32_t> start(noVertices + 1, 0);
+    for(const auto &vertices : nonEmpty)
+        for(const auto &entry : vertices)
+            start[entry.first + 1]++;
+    for(uint32_t v = 0; v < noVertices; v ++)
+        start[v + 1] += start[v];
+
+    std::vector<std::pair<uint32_t,uint32_t>> present(start[noVertices]);
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for(uint32_t a = 0; a < numAtoms; a ++)
+        for(const auto &entry : nonEmpty[a])
+            present[fill[entry.first]++] = std::make_pair(a, entry.second);
+
+    std::vector<pairScratch> scratch(noThreads);
+    for(auto &rows : scratch) {
+        rows.row.assign(numAtoms, pairSynopsis());
+        rows.used.assign(numAtoms, 0);
+        rows.stamp.assign(numAtoms, 0);
+    }
+    parallel(numAtoms, [&](uint32_t thread, uint32_t a) {
+        countPairs(a, nonEmpty, start, present, scratch[thread]);
+    });
+
+    // the targets of A/B reached from A are the sources of B^-1/A^-1 that reach A^-1. B^-1/A^-1 meet
+    // exactly where A/B do, and with A taken in the order of A^-1 every list is filled front to back.
+    std::vector<uint32_t> cursor(numAtoms, 0);
+    for(uint32_t inverse = 0; inverse < numAtoms; inverse ++)
+        for(const auto &entry : partners[inverse ^ 1u]) {
+            uint32_t mirror = entry.first ^ 1u;
+            partners[mirror][cursor[mirror]++].second.noIn = entry.second.noOut;
+        }
+}
+
+// statistics of every operand of the concatenation chain q, in order
+void SimpleEstimator::treeToList(RPQTree *q, std::vector<chainAtom> &atoms) {
     if(q->isConcat()) {
-        treeToList(q->left);
-        treeToList(q->right);
+        treeToList(q->left, atoms);
+        treeToList(q->right, atoms);
+    }
+    else if(q->isClosure()) {
+        atoms.push_back({estimateClosure(q), NO_ATOM});
     }
     else if(q->isLeaf()) {
         auto label = q->data.substr(0, q->data.size() - 1);
         std::stringstream geek(label);
         uint32_t labelInt;
         geek >> labelInt;
-        queryVector.emplace_back(std::make_pair(labelInt, q->data.at(q->data.size() - 1)));
+        if(labelInt >= numLabels) {
+            atoms.push_back({cardStat{0, 0, 0}, NO_ATOM});
+            return;
+        }
+        auto atom = 2 * labelInt + (q->data.at(q->data.size() - 1) == '+' ? 0 : 1);
+        atoms.push_back({atomData[atom].stats, (int32_t) atom});
+    }
+}
+
+// the closure repeats the estimate of its body min times (at least once, and a bounded number of
+// times), further repetitions are assumed to at most double the paths of the last one
+cardStat SimpleEstimator::estimateClosure(RPQTree *q) {
+
+    uint32_t min, max;
+    q->closureBounds(min, max);
+
+    // a single label keeps its atom, so its repetitions use the synopsis of the label with itself
+    std::vector<chainAtom> body;
+    if(q->left->isLeaf())
+        treeToList(q->left, body);
+    else
+        body.push_back({estimateUnbound(q->left), NO_ATOM});
+
+    std::vector<chainAtom> repeated(std::min(std::max(min, 1u), 8u), body[0]);
+    auto result = combine(repeated, 0, repeated.size());
+
+    uint64_t pairs = (uint64_t) result.noOut * result.noIn;
+    if(max > std::max(min, 1u))
+        result.noPaths = (uint32_t) std::min<uint64_t>(pairs, 2ull * result.noPaths);
+
+    if(min == 0) {
+        uint32_t noVertices = graph->getNoVertices();
+        result = {noVertices, (uint32_t) std::min<uint64_t>(UINT32_MAX, (uint64_t) result.noPaths + noVertices), noVertices};
+    }
+
+    return result;
+}
+
+// out-degree of v for the atom: exact for a heavy hitter, otherwise the average degree of the
+// histogram bucket holding the median vertex, which skewed labels do not drag upwards
+double SimpleEstimator::degreeOf(uint32_t atom, uint32_t v) const {
+
+    const auto &synopsis = atomData[atom];
+    for(auto &heavy : synopsis.heavyHitters)
+        if(heavy.first == v) return heavy.second;
+
+    uint64_t seen = 0;
+    for(uint32_t b = 0; b < synopsis.histogramVertices.size(); b ++) {
+        seen += synopsis.histogramVertices[b];
+        if(2 * seen >= synopsis.stats.noOut && synopsis.histogramVertices[b] > 0)
+            return (double) synopsis.histogramDegrees[b] / synopsis.histogramVertices[b];
     }
+
+    return 0;
 }
 
-cardStat reverse(cardStat c) {
-    return {c.noIn, c.noPaths, c.noOut};
+// s and t are input vertex ids, which differ from the index ids once the graph is reordered
+cardStat SimpleEstimator::estimate(RPQTree *q, uint32_t s, uint32_t t) {
+
+    s = graph->internalId(s);
+    t = graph->internalId(t);
+
+    std::vector<chainAtom> atoms;
+    treeToList(q, atoms);
+
+    auto unbound = combine(atoms, 0, atoms.size());
+    if(s == ANY_VERTEX && t == ANY_VERTEX) return unbound;
+    if(unbound.noPaths == 0 || (s != ANY_VERTEX && unbound.noOut == 0) || (t != ANY_VERTEX && unbound.noIn == 0))
+        return cardStat{0, 0, 0};
+
+    // a bound end keeps a single vertex with the average fan-out (or fan-in) of the path, scaled by
+    // how the degree of that vertex in the first (or last) label compares to the label's average
+    if(s != ANY_VERTEX && t != ANY_VERTEX) return cardStat{1, 1, 1};
+    if(s != ANY_VERTEX) {
+        double paths = (double) unbound.noPaths / unbound.noOut;
+        const auto &first = atoms.front();
+        if(first.atom != NO_ATOM && first.stats.noPaths > 0)
+            paths *= degreeOf(first.atom, s) * first.stats.noOut / first.stats.noPaths;
+        auto noPaths = (uint32_t) std::max(1.0, std::min(std::round(paths), (double) UINT32_MAX));
+        return cardStat{1, noPaths, std::min(noPaths, unbound.noIn)};
+    }
+    double paths = (double) unbound.noPaths / unbound.noIn;
+    const auto &last = atoms.back();
+    if(last.atom != NO_ATOM && last.stats.noPaths > 0)
+        paths *= degreeOf(last.atom ^ 1, t) * last.stats.noIn / last.stats.noPaths;
+    auto noPaths = (uint32_t) std::max(1.0, std::min(std::round(paths), (double) UINT32_MAX));
+    return cardStat{std::min(noPaths, unbound.noOut), noPaths, 1};
 }
 
-cardStat SimpleEstimator::estimate(RPQTree *q) {
-       treeToList(q);
+cardStat SimpleEstimator::estimateUnbound(RPQTree *q) {
 
-    if(queryVector.empty())
-    {
-        queryVector.clear();
-        return cardStat{0,0,0};
+    std::vector<chainAtom> atoms;
+    treeToList(q, atoms);
+
+    return combine(atoms, 0, atoms.size());
+}
+
+// expected distinct pairs when the given number of paths fall uniformly into the possible pairs
+double SimpleEstimator::distinct(double paths, double cells) {
+    if(paths <= 0 || cells <= 0) return 0;
+    return cells * -std::expm1(-paths / cells);
+}
+
+static cardStat toCardStat(double out, double paths, double in) {
+    auto clamp = [](double x) { return (uint32_t) std::min(std::round(std::max(x, 0.0)), (double) UINT32_MAX); };
+    return cardStat{clamp(std::min(out, paths)), clamp(paths), clamp(std::min(in, paths))};
+}
+
+// join of the chain so far with an operand that has no synopsis: join keys are assumed to be drawn
+// from the larger of the two key domains
+static void independentStep(double &out, double &paths, double &in, const cardStat &next) {
+    double raw = paths * next.noPaths / std::max({1.0, in, (double) next.noOut});
+    out = std::min(out, raw);
+    in = std::min((double) next.noIn, raw);
+    paths = SimpleEstimator::distinct(raw, out * in);
+}
+
+// Distinct targets of the chains atoms[begin, begin + k] for growing k (or distinct sources of
+// atoms[end - 1 - k, end) when walking backward), as long as the chain consists of labels. The reached
+// set is carried as its estimated size and a sample of its vertices: the sketches of the sampled
+// vertices are merged for the next label, and when the sample is only part of the set, the merged
+// count is scaled up to the whole set assuming every vertex covers the targets independently.
+std::vector<double> SimpleEstimator::reach(const std::vector<chainAtom> &atoms, size_t begin, size_t end, bool backward) const {
+
+    std::vector<double> sizes;
+    if(sketchRegisters == 0 || begin >= end) return sizes;
+
+    auto atomAt = [&](size_t k) {
+        const auto &atom = atoms[backward ? end - 1 - k : begin + k];
+        if(atom.atom == NO_ATOM) return NO_ATOM;
+        return backward ? atom.atom ^ 1 : atom.atom;
+    };
+
+    int32_t first = atomAt(0);
+    if(first == NO_ATOM) return sizes;
+
+    double size = atomData[first].stats.noIn;
+    std::vector<uint32_t> sample = atomData[first].targetSample;
+    bool exact = sample.size() == size;
+    sizes.push_back(size);
+
+    const uint32_t scanLimit = 256;
+    std::vector<uint8_t> merged(sketchRegisters);
+    std::vector<uint32_t> next;
+
+    for(size_t k = 1; k < end - begin && size > 0; k ++) {
+        int32_t atom = atomAt(k);
+        if(atom == NO_ATOM) break;
+
+        const auto &index = indexOf(*graph, (uint32_t) atom);
+
+        std::fill(merged.begin(), merged.end(), 0);
+        next.clear();
+        for(auto v : sample) {
+            const uint8_t *sketch = sketchOf((uint32_t) atom, v);
+            if(sketch != nullptr) HyperLogLog::merge(merged.data(), sketch, sketchRegisters);
+
+            // a bounded part of every neighbour list is enough to draw the next sample from
+            exact = index.appendTo(v, next, scanLimit) && exact;
+        }
+
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+
+        double covered = HyperLogLog::estimate(merged.data(), sketchRegisters);
+        double universe = std::max(1u, atomData[atom].stats.noIn);
+        if(exact && next.size() <= sampleSize) {
+            size = next.size();
+        } else {
+            double share = std::min(covered / universe, 1.0 - 1e-12);
+            size = std::max(covered, universe * -std::expm1(size / std::max<size_t>(1, sample.size()) * std::log1p(-share)));
+            exact = false;
+        }
+        size = std::min(size, universe);
+        sizes.push_back(size);
+
+        sample.clear();
+        for(auto v : next)
+            addToSample(sample, v, sampleSize, sampleSeed);
     }
-    else if(queryVector.size()==1)
-    {
-        cardStat onlyOne=labelData[queryVector[0].first];
-        queryVector.clear();
-        if(queryVector[0].second == '+')
-            return onlyOne;
-        else return reverse(onlyOne);
+
+    return sizes;
+}
+
+// estimate of the concatenation of atoms[begin, end). Where two labels meet, their synopsis gives the
+// exact join size and endpoints. Later in the chain only part of the first label's targets are
+// reached, which keeps a source when any of its paths ends in a join key, and a target when any of
+// the join keys leading to it is reached. Chains of three or more labels take their distinct
+// sources and targets from the sketches instead, when there are any.
+cardStat SimpleEstimator::combine(const std::vector<chainAtom> &atoms, size_t begin, size_t end) const {
+
+    double sketchOut = -1, sketchIn = -1;
+    if(end - begin >= 3) {
+        auto targets = reach(atoms, begin, end, false);
+        auto sources = reach(atoms, begin, end, true);
+        if(targets.size() == end - begin) sketchIn = targets.back();
+        if(sources.size() == end - begin) sketchOut = sources.back();
     }
-    else
-    {
-        cardStat left;
-        if(queryVector[0].second == '+')
-            left = labelData[queryVector[0].first];
-        else left = reverse(labelData[queryVector[0].first]);
-
-        uint32_t total = (left.noIn + left.noOut) / 2;
-        uint32_t one = 1;
-        for(int i=1; i<queryVector.size();i++)
-        {
-            cardStat right;
-            if(queryVector[i].second == '+')
-                right = labelData[queryVector[i].first];
-            else right = reverse(labelData[queryVector[i].first]);
-
-            uint32_t in = (left.noIn)/ 4;
-            uint32_t out = (right.noOut) / 4;
-            total /= 4;
-            auto paths = std::min(2 * left.noPaths * right.noPaths / std::max((right.noIn + right.noOut + total), one),
-                                  2 * left.noPaths * right.noPaths / std::max((left.noOut + left.noIn + total), one));
-            cardStat processed = cardStat{std::min(out, paths), paths, std::min(in, paths)};
-            left = processed;
+
+    return combine(atoms, begin, end, sketchOut, sketchIn);
+}
+
+// estimates of every sub-chain, card[i][j] for atoms[i..j], sharing one sketch walk per start and end
+void SimpleEstimator::combineAll(const std::vector<chainAtom> &atoms, std::vector<std::vector<cardStat>> &card) const {
+
+    size_t n = atoms.size();
+    std::vector<std::vector<double>> targets(n), sources(n);
+    for(size_t i = 0; i < n; i ++) {
+        targets[i] = reach(atoms, i, n, false);
+        sources[i] = reach(atoms, 0, i + 1, true);
+    }
+
+    for(size_t i = 0; i < n; i ++) {
+        for(size_t j = i; j < n; j ++) {
+            size_t length = j - i + 1;
+            double sketchIn = length >= 3 && targets[i].size() >= length ? targets[i][length - 1] : -1;
+            double sketchOut = length >= 3 && sources[j].size() >= length ? sources[j][length - 1] : -1;
+            card[i][j] = combine(atoms, i, j + 1, sketchOut, sketchIn);
+        }
+    }
+}
+
+cardStat SimpleEstimator::combine(const std::vector<chainAtom> &atoms, size_t begin, size_t end, double sketchOut, double sketchIn) const {
+
+    if(begin >= end) return cardStat{0, 0, 0};
+
+    double out = atoms[begin].stats.noOut;
+    double paths = atoms[begin].stats.noPaths;
+    double in = atoms[begin].stats.noIn;
+    double raw = paths;
+
+    for(size_t k = begin + 1; k < end && paths > 0; k ++) {
+        const auto &prev = atoms[k - 1];
+        const auto &next = atoms[k];
+
+        if(prev.atom == NO_ATOM || next.atom == NO_ATOM) {
+            independentStep(out, paths, in, next.stats);
+            raw = paths;
+            continue;
+        }
+
+        const auto &pair = pairOf((uint32_t) prev.atom, (uint32_t) next.atom);
+        if(pair.joinSize == 0) return cardStat{0, 0, 0};
+
+        raw = paths * pair.joinSize / std::max(1u, prev.stats.noPaths);
+        if(k == begin + 1) {
+            out = pair.noOut;
+            in = pair.noIn;
+        } else {
+            double keyShare = (double) pair.noKeys / std::max(1u, prev.stats.noIn);
+            double reachedShare = std::min(1.0, in / std::max(1u, prev.stats.noIn));
+            double keysPerTarget = (double) pair.keyEdges / std::max(1u, pair.noIn);
+            out *= -std::expm1(paths / std::max(1.0, out) * std::log1p(-std::min(keyShare, 1.0 - 1e-12)));
+            in = pair.noIn * -std::expm1(keysPerTarget * std::log1p(-std::min(reachedShare, 1.0 - 1e-12)));
         }
-        queryVector.clear();
-        return left;
+        paths = distinct(raw, out * in);
+    }
+
+    if(paths > 0 && (sketchOut >= 0 || sketchIn >= 0)) {
+        if(sketchOut >= 0) out = sketchOut;
+        if(sketchIn >= 0) in = sketchIn;
+        paths = distinct(raw, out * in);
     }
+
+    return toCardStat(out, paths, in);
+}
+
+cardStat SimpleEstimator::chain(const std::vector<cardStat> &atoms) {
+    return chain(atoms, 0, atoms.size());
+}
+
+// estimate of the concatenation of atoms[begin, end) from their statistics alone
+cardStat SimpleEstimator::chain(const std::vector<cardStat> &atoms, size_t begin, size_t end) {
+
+    if(begin >= end) return cardStat{0, 0, 0};
+
+    double out = atoms[begin].noOut;
+    double paths = atoms[begin].noPaths;
+    double in = atoms[begin].noIn;
+
+    for(size_t k = begin + 1; k < end && paths > 0; k ++)
+        independentStep(out, paths, in, atoms[k]);
+
+    return toCardStat(out, paths, in);
 }
@@ -4,6 +4,13 @@
 
 #include "SimpleEstimator.h"
 #include "SimpleEvaluator.h"
+#include "JoinKernels.h"
+#include "MultiSourceBFS.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <limits>
+#include <functional>
 
 SimpleEvaluator::SimpleEvaluator(std::shared_ptr<SimpleGraph> &g) {
 
@@ -14,6 +21,42 @@ SimpleEvaluator::SimpleEvaluator(std::shared_ptr<SimpleGraph> &g) {
 
 void SimpleEvaluator::attachEstimator(std::shared_ptr<SimpleEstimator> &e) {
     est = e;
+    plans.clear();
+}
+
+// operators split large inputs into partitions that run on the pool
+void SimpleEvaluator::attachPool(std::shared_ptr<ThreadPool> &p) {
+    pool = p;
+}
+
+// intermediate relations are kept across queries and reused by any query sharing the sub-path
+void SimpleEvaluator::attachResultCache(std::shared_ptr<ResultCache> &r) {
+    results = r;
+}
+
+// buffers for intermediate relations and scratch arrays, reused by later operators and queries
+void SimpleEvaluator::attachRelationPool(std::shared_ptr<RelationPool> &b) {
+    buffers = b;
+}
+
+// chains of labels are streamed through the indexes in batches instead of joined
+void SimpleEvaluator::setPipelining(bool enabled) {
+    pipelined = enabled;
+}
+
+// two-label paths to materialize in prepare(), the most frequent first, within budget bytes; without
+// a list the paths that save the most join work are chosen
+void SimpleEvaluator::configurePathIndex(const std::vector<std::string> &frequent, size_t budget) {
+    frequentPaths = frequent;
+    pathBudget = budget;
+}
+
+const PathIndex &SimpleEvaluator::getPathIndex() const {
+    return twoHop;
+}
+
+PlanCache &SimpleEvaluator::getPlanCache() {
+    return plans;
 }
 
 void SimpleEvaluator::prepare() {
@@ -21,123 +64,564 @@ void SimpleEvaluator::prepare() {
     // if attached, prepare the estimator
     if(est != nullptr) est->prepare();
 
-    // prepare other things here.., if necessary
+    // plans chosen with the previous statistics are no longer trusted
+    plans.clear();
+
+    if(pathBudget > 0)
+        twoHop.build(*graph, frequentPaths, pathBudget);
+    else
+        twoHop.clear();
 
 }
 
 cardStat SimpleEvaluator::computeStats(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &g) {
 
-    return {0, g->size(), 0};
+    cardStat stats {0, (uint32_t) g->size(), 0};
+
+    // relations are sorted by source, targets are counted through a bitset
+    std::vector<bool> targets;
+    for(uint32_t i = 0; i < g->size(); i ++) {
+        if(i == 0 || (*g)[i].first != (*g)[i - 1].first) stats.noOut++;
+
+        uint32_t t = (*g)[i].second;
+        if(t >= targets.size()) targets.resize(std::max<size_t>(t + 1, 2 * targets.size()), false);
+        if(!targets[t]) {
+            targets[t] = true;
+            stats.noIn++;
+        }
+    }
+
+    return stats;
 }
 
-std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::project(uint32_t projectLabel, bool inverse, std::shared_ptr<SimpleGraph> &in) {
+static explainNode *addChild(explainNode *node);
 
-    auto out = std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
+// exact cardinalities of the result of q without materializing it: only the children of the
+// top-level operator are built, its output is counted one source at a time and, with a sink, handed
+// to it as it is counted
+cardStat SimpleEvaluator::countStats(RPQTree *q, explainNode *node, resultBatch *sink) {
 
-    if(in->adj.empty()) {
-        return out;
+    uint32_t label;
+    bool inverse;
+    cardCounter counter(graph->getNoVertices(), buffers.get());
+    if(node != nullptr) node->children.reserve(2);
+
+    // sorting an input that is not sorted yet is the only sort or deduplication of a count
+    uint64_t sortNanos = 0;
+    auto sortInput = [&](std::vector<std::pair<uint32_t,uint32_t>> &relation) {
+        uint64_t start = node != nullptr ? kernelStats::now() : 0;
+        JoinKernels::sorted(relation, buffers.get());
+        if(node != nullptr) sortNanos += kernelStats::now() - start;
+    };
+
+    auto finish = [&](const char *op, uint64_t rowsIn, uint64_t rowsRaw) {
+        if(node != nullptr) {
+            node->op = op;
+            node->rowsIn = rowsIn;
+            node->rowsRaw = rowsRaw;
+            node->sortMillis = sortNanos / 1e6;
+        }
+    };
+
+    if(q->isLeaf()) {
+        if(!parseLabel(q->data, label, inverse)) return {0, 0, 0};
+        if(label >= graph->fwd.size()) return {0, 0, 0};
+
+        const auto &out = inverse ? graph->rev[label] : graph->fwd[label];
+        const auto &in = inverse ? graph->fwd[label] : graph->rev[label];
+        finish("scan", 0, out.size());
+        if(sink != nullptr) out.scan(0, graph->getNoVertices(), [&](uint32_t v, uint32_t n) { sink->add(v, n); });
+        return {out.noNonEmpty, out.size(), in.noNonEmpty};
+    }
+
+    else if(q->isConcat()) {
+
+        auto leftGraph = SimpleEvaluator::evaluate_aux(q->left, addChild(node));
+        if(leftGraph == nullptr || leftGraph->empty()) return {0, 0, 0};
+        sortInput(*leftGraph);
+        uint64_t rowsIn = leftGraph->size();
+
+        // neighbours of a join key, either straight from the index or from the materialized right side
+        const CSRIndex *index = nullptr;
+        std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> rightGraph;
+        RelationPool::scratch pos(buffers.get(), 0);
+
+        if(q->right->isLeaf()) {
+            if(!parseLabel(q->right->data, label, inverse)) return {0, 0, 0};
+            if(label >= graph->fwd.size()) return {0, 0, 0};
+            index = inverse ? &graph->rev[label] : &graph->fwd[label];
+            indexNode(q->right, node);
+        } else if(twoHop.find(q->right) != nullptr) {
+            index = twoHop.find(q->right);
+            indexNode(q->right, node);
+        } else {
+            rightGraph = SimpleEvaluator::evaluate_aux(q->right, addChild(node));
+            if(rightGraph == nullptr || rightGraph->empty()) return {0, 0, 0};
+            sortInput(*rightGraph);
+            pos.reset(graph->getNoVertices() + 1);
+            offsets(*rightGraph, pos.data);
+            rowsIn += rightGraph->size();
+        }
+
+        uint64_t rowsRaw = 0;
+        for(uint32_t i = 0; i < leftGraph->size(); ) {
+            counter.beginSource((*leftGraph)[i].first);
+            for(uint32_t source = (*leftGraph)[i].first; i < leftGraph->size() && (*leftGraph)[i].first == source; i ++) {
+                uint32_t key = (*leftGraph)[i].second;
+                if(index != nullptr) {
+                    rowsRaw += index->degree(key);
+                    index->forEach(key, [&](uint32_t n) {
+                        if(counter.add(n) && sink != nullptr) sink->add(source, n);
+                    });
+                } else {
+                    rowsRaw += pos[key + 1] - pos[key];
+                    for(uint32_t j = pos[key]; j < pos[key + 1]; j ++)
+                        if(counter.add((*rightGraph)[j].second) && sink != nullptr) sink->add(source, (*rightGraph)[j].second);
+                }
+            }
+            counter.endSource();
+        }
+
+        finish("count", rowsIn, rowsRaw);
+        return counter.stats;
     }
 
-    for (const auto &edge : in->adj[projectLabel]) {
-        if(!inverse)
-            out->emplace_back(edge.first, edge.second);
-        else
-            out->emplace_back(edge.second, edge.first);
+    else if(q->isClosure()) {
+
+        uint32_t min, max;
+        q->closureBounds(min, max);
+
+        auto base = SimpleEvaluator::evaluate_aux(q->left, addChild(node));
+        if(base == nullptr) return {0, 0, 0};
+        sortInput(*base);
+
+        RelationPool::scratch pos(buffers.get(), graph->getNoVertices() + 1);
+        offsets(*base, pos.data);
+
+        // per-source search over the base relation: exact levels up to min, then only new vertices
+        RelationPool::scratch level(buffers.get(), graph->getNoVertices());
+        uint32_t levelStamp = 0;
+        std::vector<uint32_t> frontier, next;
+
+        for(uint32_t source = 0; source < graph->getNoVertices(); source ++) {
+            if(min > 0 && pos[source] == pos[source + 1]) continue;
+
+            frontier.assign(1, source);
+            for(uint32_t k = 0; k < min && !frontier.empty(); k ++) {
+                levelStamp++;
+                next.clear();
+                for(auto v : frontier)
+                    for(uint32_t j = pos[v]; j < pos[v + 1]; j ++)
+                        if(level[(*base)[j].second] != levelStamp) {
+                            level[(*base)[j].second] = levelStamp;
+                            next.push_back((*base)[j].second);
+                        }
+                frontier.swap(next);
+            }
+
+            counter.beginSource(source);
+            next.clear();
+            for(auto v : frontier)
+                if(counter.add(v)) {
+                    next.push_back(v);
+                    if(sink != nullptr) sink->add(source, v);
+                }
+            frontier.swap(next);
+
+            for(uint32_t k = min; k < max && !frontier.empty(); k ++) {
+                next.clear();
+                for(auto v : frontier)
+                    for(uint32_t j = pos[v]; j < pos[v + 1]; j ++)
+                        if(counter.add((*base)[j].second)) {
+                            next.push_back((*base)[j].second);
+                            if(sink != nullptr) sink->add(source, (*base)[j].second);
+                        }
+                frontier.swap(next);
+            }
+            counter.endSource();
+        }
+
+        finish("closure-count", base->size(), counter.stats.noPaths);
+        return counter.stats;
     }
 
-    return out;
+    return {0, 0, 0};
+}
+
+// start of the group of every source in a sorted relation, pos holds a zero for every vertex and one more
+void SimpleEvaluator::offsets(const std::vector<std::pair<uint32_t,uint32_t>> &relation, std::vector<uint32_t> &pos) {
+
+    for(const auto &edge : relation)
+        pos[edge.first + 1]++;
+    for(uint32_t i = 1; i < pos.size(); i ++)
+        pos[i] += pos[i - 1];
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::project(uint32_t projectLabel, bool inverse, std::shared_ptr<SimpleGraph> &in, ThreadPool *pool, RelationPool *buffers) {
+
+    if(projectLabel >= in->fwd.size()) {
+        return RelationPool::relation(buffers, 0);
+    }
+
+    // the reverse index already holds the inverse label sorted by its new source
+    return SimpleEvaluator::project(inverse ? in->rev[projectLabel] : in->fwd[projectLabel], pool, buffers);
 }
 
-std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right) {
+// every pair of a label or path index, which is already sorted by source
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::project(const CSRIndex &index, ThreadPool *pool, RelationPool *buffers) {
+
+    auto out = RelationPool::relation(buffers, index.size());
+    out->resize(index.size());
 
-    auto out = std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
+    // every vertex range fills the output in place from the position of its first pair
+    auto copyRange = [&](uint32_t from, uint32_t to, uint32_t pos) {
+        index.scan(from, to, [&](uint32_t v, uint32_t n) { (*out)[pos++] = std::make_pair(v, n); });
+    };
 
-    if(left->empty() || right->empty()) {
+    uint32_t noVertices = index.noVertices;
+    if(pool == nullptr || index.size() < JoinKernels::parallelThreshold) {
+        copyRange(0, noVertices, 0);
         return out;
     }
 
-    std::sort(right->begin(), right->end(), SimpleGraph::sortPairsFirst);
-    std::vector<uint32_t> pos;
-    pos.resize(right->back().first + 1);
+    // vertex ranges holding about the same number of edges, a compressed index is split on the
+    // bytes of its lists at word boundaries of its bitmap
+    uint32_t parts = 4 * pool->size();
+    std::vector<uint32_t> bounds(parts + 1, noVertices);
+    bounds[0] = 0;
+    for(uint32_t p = 1; p < parts; p ++) {
+        if(!index.compressed) {
+            bounds[p] = (uint32_t) (std::upper_bound(index.offsets, index.offsets + noVertices, (uint64_t) index.size() * p / parts) - index.offsets);
+            continue;
+        }
+        auto list = (uint32_t) (std::lower_bound(index.listStarts.begin(), index.listStarts.end(), (uint64_t) index.packed.size() * p / parts) - index.listStarts.begin());
+        auto word = std::upper_bound(index.presentRank.begin(), index.presentRank.end(), list) - index.presentRank.begin();
+        bounds[p] = (uint32_t) std::min<uint64_t>(noVertices, 64 * (uint64_t) std::max<ptrdiff_t>(0, word - 1));
+    }
+    for(uint32_t p = 1; p <= parts; p ++)
+        bounds[p] = std::max(bounds[p], bounds[p - 1]);
 
-    for(uint32_t i = 0; i < pos.size(); i ++) {
-        pos[i] = right->size();
+    // the position of the first pair of every range, counted from the degrees when the index is compressed
+    std::vector<uint32_t> first(parts + 1, 0);
+    if(!index.compressed) {
+        for(uint32_t p = 0; p <= parts; p ++)
+            first[p] = index.offsets[bounds[p]];
+    } else {
+        pool->parallelFor(parts, [&](uint32_t p) {
+            for(uint32_t v = bounds[p]; v < bounds[p + 1]; v ++)
+                first[p + 1] += index.degree(v);
+        });
+        for(uint32_t p = 1; p <= parts; p ++)
+            first[p] += first[p - 1];
     }
 
-    for(uint32_t j = 0; j < right->size(); j ++) {
-        if(j < pos[right->at(j).first])
-            pos[right->at(j).first] = j;
+    pool->parallelFor(parts, [&](uint32_t p) {
+        copyRange(bounds[p], bounds[p + 1], first[p]);
+    });
+
+    return out;
+}
+
+// relations are kept sorted on (first, second) without duplicates, the kernel is picked from
+// the input sizes and whether the inputs are already sorted
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::join(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &right, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    return JoinKernels::join(left, right, pool, stats, buffers);
+}
+
+// join with a label directly through its index, without projecting it out first
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::expand(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, uint32_t label, bool inverse, std::shared_ptr<SimpleGraph> &g, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    if(left->empty() || label >= g->fwd.size()) {
+        return RelationPool::relation(buffers, 0);
     }
 
-    for(uint32_t i = 0; i < left->size(); i ++) {
-        if(left->at(i).second < pos.size()) {
-            for (uint32_t j = pos[left->at(i).second]; j < right->size(); j++) {
-                if (out->empty()) {
-                    if (left->at(i).second == right->at(j).first)
-                        out->emplace_back(left->at(i).first, right->at(j).second);
-                    else break;
-                } else {
-                    if (left->at(i).second != right->at(j).first) {
-                        break;
-                    } else if (left->at(i).first != out->back().first || right->at(j).second != out->back().second)
-                        out->emplace_back(left->at(i).first, right->at(j).second);
-                }
+    return SimpleEvaluator::expand(left, inverse ? g->rev[label] : g->fwd[label], pool, stats, buffers);
+}
+
+// left joined with a label or path index by looking up the neighbours of every target of left,
+// a pooled output starts at the size of left
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::expand(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &left, const CSRIndex &index, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    if(left->empty()) {
+        return RelationPool::relation(buffers, 0);
+    }
+
+    auto out = RelationPool::relation(buffers, left->size());
+
+    uint64_t start = stats != nullptr ? kernelStats::now() : 0;
+    JoinKernels::sorted(*left, buffers);
+    if(stats != nullptr) stats->sortNanos += kernelStats::now() - start;
+
+    auto expandRange = [&](size_t begin, size_t end, std::vector<std::pair<uint32_t,uint32_t>> &run, kernelStats *rangeStats) {
+        std::vector<uint32_t> targets;
+        for(size_t i = begin; i < end; ) {
+            uint32_t source = (*left)[i].first;
+
+            targets.clear();
+            for(; i < end && (*left)[i].first == source; i ++)
+                index.appendTo((*left)[i].second, targets);
+
+            if(rangeStats == nullptr) {
+                appendGroup(source, targets, run);
+                continue;
             }
+
+            // the group is sorted and deduplicated into the run, the time is charged to sorting
+            uint64_t groupStart = kernelStats::now();
+            rangeStats->rawTuples += targets.size();
+            appendGroup(source, targets, run);
+            rangeStats->sortNanos += kernelStats::now() - groupStart;
         }
+    };
+
+    if(pool == nullptr || left->size() < JoinKernels::parallelThreshold) {
+        expandRange(0, left->size(), *out, stats);
+        return out;
     }
-    if(!out->empty()) {
-        std::sort(out->begin(), out->end());
-        out->erase(unique(out->begin(), out->end()), out->end());
-    }
+
+    // source ranges of left produce sorted runs that only need to be concatenated
+    auto bounds = JoinKernels::groupBounds(*left, 4 * pool->size());
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> runs(bounds.size() - 1);
+    std::vector<kernelStats> partStats(runs.size());
+    pool->parallelFor((uint32_t) runs.size(), [&](uint32_t part) {
+        expandRange(bounds[part], bounds[part + 1], runs[part], stats != nullptr ? &partStats[part] : nullptr);
+    });
+    JoinKernels::concat(runs, *out);
+
+    if(stats != nullptr)
+        for(auto &part : partStats)
+            stats->add(part);
+
     return out;
 }
 
-std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::evaluate_aux(RPQTree *q) {
+void SimpleEvaluator::appendGroup(uint32_t source, std::vector<uint32_t> &targets, std::vector<std::pair<uint32_t,uint32_t>> &out) {
 
-    // evaluate according to the AST bottom-up
+    std::sort(targets.begin(), targets.end());
+    auto last = std::unique(targets.begin(), targets.end());
 
-    if(q->isLeaf()) {
-        // project out the label in the AST
-        std::regex directLabel (R"((\d+)\+)");
-        std::regex inverseLabel (R"((\d+)\-)");
+    for(auto t = targets.begin(); t != last; t ++)
+        out.emplace_back(source, *t);
+}
 
-        std::smatch matches;
+bool SimpleEvaluator::parseLabel(const std::string &data, uint32_t &label, bool &inverse) {
 
-        uint32_t label;
-        bool inverse;
+    std::regex labelPat (R"((\d+)([\+\-]))");
+    std::smatch matches;
 
-        if(std::regex_search(q->data, matches, directLabel)) {
-            label = (uint32_t) std::stoul(matches[1]);
-            inverse = false;
-        } else if(std::regex_search(q->data, matches, inverseLabel)) {
-            label = (uint32_t) std::stoul(matches[1]);
-            inverse = true;
-        } else {
-            std::cerr << "Label parsing failed!" << std::endl;
-            return nullptr;
+    if(!std::regex_search(data, matches, labelPat)) {
+        std::cerr << "Label parsing failed!" << std::endl;
+        return false;
+    }
+
+    label = (uint32_t) std::stoul(matches[1]);
+    inverse = matches[2] == "-";
+    return true;
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::evaluate_aux(RPQTree *q, explainNode *node) {
+
+    if(results == nullptr || q->isLeaf() || twoHop.find(q) != nullptr) return measure(q, node);
+
+    // sub-paths materialized by earlier queries are looked up before anything is built
+    auto key = PlanCache::canonical(q);
+    auto start = std::chrono::steady_clock::now();
+    auto result = results->get(key, graph->getVersion());
+    if(result != nullptr) {
+        if(node != nullptr) {
+            beginNode(q, *node);
+            node->op = "cached";
+            endNode(*node, result, start);
         }
+        return result;
+    }
 
-        return SimpleEvaluator::project(label, inverse, graph);
+    result = measure(q, node);
+    if(result != nullptr) results->put(key, graph->getVersion(), result);
+    return result;
+}
+
+// materialize q, recording what was done into node when the query is explained
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::measure(RPQTree *q, explainNode *node) {
+
+    if(node == nullptr) return materialize(q);
+
+    beginNode(q, *node);
+    auto start = std::chrono::steady_clock::now();
+    auto result = materialize(q, node);
+    endNode(*node, result, start);
+    return result;
+}
+
+void SimpleEvaluator::beginNode(RPQTree *q, explainNode &node) {
+
+    node.path = PlanCache::canonical(q);
+    if(est != nullptr) {
+        node.estimated = true;
+        node.estimate = est->estimate(q);
+    }
+}
+
+// the output of the node is held together with the outputs of its children while it is built
+void SimpleEvaluator::endNode(explainNode &node, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &result, std::chrono::steady_clock::time_point start) {
+
+    node.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    node.analyzed = true;
+
+    uint64_t inputs = 0;
+    for(const auto &child : node.children) {
+        inputs += child.bytesOut;
+        node.peakBytes = std::max(node.peakBytes, child.peakBytes);
+    }
+
+    if(result != nullptr) {
+        node.actual = computeStats(result);
+        node.bytesOut = result->size() * sizeof(std::pair<uint32_t,uint32_t>);
+    }
+    node.peakBytes = std::max(node.peakBytes, inputs + node.bytesOut);
+}
+
+// a new child of node, or nothing when the query is not explained
+static explainNode *addChild(explainNode *node) {
+
+    if(node == nullptr) return nullptr;
+    node->children.emplace_back();
+    return &node->children.back();
+}
+
+// the right side of an expansion, read from an index rather than materialized
+void SimpleEvaluator::indexNode(RPQTree *q, explainNode *node) {
+
+    auto child = addChild(node);
+    if(child == nullptr) return;
+
+    beginNode(q, *child);
+    child->op = q->isLeaf() ? "index" : "path-index";
+}
+
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::materialize(RPQTree *q, explainNode *node) {
+
+    // evaluate according to the AST bottom-up
+
+    uint32_t label;
+    bool inverse;
+
+    // work of the operator itself, only collected when the query is explained
+    kernelStats work;
+    kernelStats *stats = node != nullptr ? &work : nullptr;
+    if(node != nullptr) node->children.reserve(2);
+
+    auto finish = [&](const char *op, uint64_t rowsIn, std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> result) {
+        if(node != nullptr) {
+            node->op = op;
+            node->rowsIn = rowsIn;
+            node->rowsRaw = work.rawTuples;
+            node->sortMillis = work.sortNanos / 1e6;
+        }
+        return result;
+    };
+
+    if(q->isLeaf()) {
+        // project out the label in the AST
+        if(!parseLabel(q->data, label, inverse)) return nullptr;
+
+        return finish("scan", 0, SimpleEvaluator::project(label, inverse, graph, pool.get(), buffers.get()));
     }
 
     else if(q->isConcat()) {
 
+        // a precomputed two-label path is read like a label
+        if(auto path = twoHop.find(q))
+            return finish("path-scan", 0, SimpleEvaluator::project(*path, pool.get(), buffers.get()));
+
         // evaluate the children
-        auto leftGraph = SimpleEvaluator::evaluate_aux(q->left);
-        auto rightGraph = SimpleEvaluator::evaluate_aux(q->right);
+        auto leftGraph = SimpleEvaluator::evaluate_aux(q->left, addChild(node));
+        if(leftGraph == nullptr) return nullptr;
+        uint64_t rowsIn = leftGraph->size();
+
+        // a label on the right is looked up in the index instead of being projected
+        if(q->right->isLeaf()) {
+            if(!parseLabel(q->right->data, label, inverse)) return nullptr;
+            indexNode(q->right, node);
+            return finish("expand", rowsIn, SimpleEvaluator::expand(leftGraph, label, inverse, graph, pool.get(), stats, buffers.get()));
+        }
+        if(auto path = twoHop.find(q->right)) {
+            indexNode(q->right, node);
+            return finish("expand", rowsIn, SimpleEvaluator::expand(leftGraph, *path, pool.get(), stats, buffers.get()));
+        }
+
+        auto rightGraph = SimpleEvaluator::evaluate_aux(q->right, addChild(node));
+        if(rightGraph == nullptr) return nullptr;
+        rowsIn += rightGraph->size();
 
         // join left with right
-        return SimpleEvaluator::join(leftGraph, rightGraph);
+        return finish("join", rowsIn, SimpleEvaluator::join(leftGraph, rightGraph, pool.get(), stats, buffers.get()));
 
     }
 
+    else if(q->isClosure()) {
+
+        uint32_t min, max;
+        q->closureBounds(min, max);
+
+        auto base = SimpleEvaluator::evaluate_aux(q->left, addChild(node));
+        if(base == nullptr) return nullptr;
+
+        return finish("closure", base->size(), SimpleEvaluator::closure(base, min, max, graph->getNoVertices(), pool.get(), stats, buffers.get()));
+    }
+
     return nullptr;
 }
 
+// union of R^k for min <= k <= max by semi-naive iteration: once R^min is known, every round
+// joins only the pairs that were new in the previous round with the base relation
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> SimpleEvaluator::closure(std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> &base, uint32_t min, uint32_t max, uint32_t noVertices, ThreadPool *pool, kernelStats *stats, RelationPool *buffers) {
+
+    // zero repetitions relate every vertex to itself
+    auto identity = RelationPool::relation(buffers, min == 0 ? noVertices : 0);
+    if(min == 0) {
+        identity->reserve(noVertices);
+        for(uint32_t v = 0; v < noVertices; v ++)
+            identity->emplace_back(v, v);
+        if(max == 0) return identity;
+    }
+
+    auto result = base;
+    for(uint32_t k = 1; k < min && !result->empty(); k ++)
+        result = SimpleEvaluator::join(result, base, pool, stats, buffers);
+
+    auto delta = result;
+    for(uint32_t k = std::max(min, 1u); k < max && !delta->empty(); k ++) {
+        auto next = SimpleEvaluator::join(delta, base, pool, stats, buffers);
+
+        // removing the pairs found in earlier rounds is deduplication as well
+        uint64_t start = stats != nullptr ? kernelStats::now() : 0;
+        delta = RelationPool::relation(buffers, next->size());
+        std::set_difference(next->begin(), next->end(), result->begin(), result->end(), std::back_inserter(*delta));
+
+        auto merged = RelationPool::relation(buffers, result->size() + delta->size());
+        merged->reserve(result->size() + delta->size());
+        std::merge(result->begin(), result->end(), delta->begin(), delta->end(), std::back_inserter(*merged));
+        result = merged;
+        if(stats != nullptr) stats->sortNanos += kernelStats::now() - start;
+    }
+
+    if(min == 0) {
+        auto merged = RelationPool::relation(buffers, identity->size() + result->size());
+        merged->reserve(identity->size() + result->size());
+        std::set_union(identity->begin(), identity->end(), result->begin(), result->end(), std::back_inserter(*merged));
+        result = merged;
+    }
+
+    return result;
+}
+
 
+// the operands of the top-level concatenation chain, a closure counts as a single operand
 std::vector<RPQTree*> SimpleEvaluator::find_leaves(RPQTree *query) {
     std::vector<RPQTree*> final;
-    if (query->isLeaf()) {
+    if (!query->isConcat()) {
         return {query};
     }
 
@@ -153,83 +637,513 @@ std::vector<RPQTree*> SimpleEvaluator::find_leaves(RPQTree *query) {
     return final;
 }
 
-RPQTree* SimpleEvaluator::query_optimizer(RPQTree *query) {
-    std::vector<RPQTree*> ls = find_leaves(query);
-
-    while (ls.size() > 1) {
-        RPQTree *best_plan = nullptr;
-        uint32_t better_result;
-        bool first = true;
-        int index = -1;
-
-        for (int i = 0; i < ls.size() - 1; i ++) {
-            std::string data("/");
-            auto *c_plan = new RPQTree(data, ls[i], ls[i + 1]);
-            uint32_t c_result = est->estimate(c_plan).noPaths;
-            if(first) {
-                better_result = c_result;
-                best_plan = c_plan;
-                index = i;
-                first = false;
-            }
-            else if (better_result > c_result) {
-                better_result = c_result;
-                best_plan = c_plan;
-                index = i;
+// cost of materializing a join of left and right into a sorted, duplicate-free relation: the raw
+// pairs produced before deduplication, plus sorting the targets of every source of left. The join at
+// the root of a plan is only counted, which needs no sort.
+static double joinCost(const cardStat &left, const cardStat &right, const cardStat &out, bool root) {
+
+    double raw = (double) left.noPaths * right.noPaths / std::max({1u, left.noIn, right.noOut});
+    raw = std::max(raw, (double) out.noPaths);
+
+    if(root) return raw;
+    return raw + raw * std::log2(raw / std::max(left.noOut, 1u) + 2);
+}
+
+// what the planner knows about a chain besides its cardinalities: which adjacent labels have a
+// precomputed path, and which sub-chains an earlier query already materialized
+void SimpleEvaluator::chainShortcuts(const std::vector<RPQTree*> &operands, std::vector<bool> &indexed, std::vector<std::vector<bool>> &cached) {
+
+    size_t n = operands.size();
+    indexed.assign(n, false);
+    cached.assign(n, std::vector<bool>(n, false));
+
+    for(size_t i = 0; i + 1 < n; i ++)
+        indexed[i] = operands[i]->isLeaf() && operands[i + 1]->isLeaf() && twoHop.find(operands[i]->data + "/" + operands[i + 1]->data) != nullptr;
+
+    if(results == nullptr) return;
+
+    std::vector<std::string> texts;
+    for(auto operand : operands)
+        texts.push_back(PlanCache::canonical(operand));
+
+    for(size_t i = 0; i < n; i ++) {
+        std::string key = texts[i];
+        for(size_t j = i + 1; j < n; j ++) {
+            key += "/" + texts[j];
+            cached[i][j] = results->contains(key, graph->getVersion());
+        }
+    }
+}
+
+// cost of operands i..j split after operand k, given the cost of both sides: a single label or
+// precomputed path on the right is read through its index, anything else is materialized and read
+// once more by the join
+static double splitCost(const std::vector<RPQTree*> &operands, const std::vector<std::vector<cardStat>> &card, const std::vector<bool> &indexed,
+                        size_t i, size_t k, size_t j, double leftCost, double rightCost) {
+
+    bool root = i == 0 && j + 1 == operands.size();
+    const auto &left = card[i][k];
+    const auto &right = card[k + 1][j];
+
+    if((k + 1 == j && operands[j]->isLeaf()) || (k + 2 == j && indexed[k + 1]))
+        return leftCost + joinCost(left, right, card[i][j], root);
+    return leftCost + rightCost + left.noPaths + right.noPaths + joinCost(left, right, card[i][j], root);
+}
+
+// estimates of every sub-chain of the operands, card[i][j] for operands i..j
+std::vector<std::vector<cardStat>> SimpleEvaluator::estimateChain(const std::vector<RPQTree*> &operands) {
+
+    std::vector<chainAtom> atoms;
+    for(auto operand : operands)
+        est->treeToList(operand, atoms);
+
+    size_t n = operands.size();
+    std::vector<std::vector<cardStat>> card(n, std::vector<cardStat>(n));
+    for(size_t i = 0; i < n; i ++)
+        card[i][i] = atoms[i].stats;
+
+    est->combineAll(atoms, card);
+    return card;
+}
+
+// exact cardinalities of every sub-chain of the operands, one evaluation each
+std::vector<std::vector<cardStat>> SimpleEvaluator::exactChain(const std::vector<RPQTree*> &operands) {
+
+    size_t n = operands.size();
+    std::vector<std::vector<cardStat>> card(n, std::vector<cardStat>(n));
+
+    std::string data("/");
+    for(size_t i = 0; i < n; i ++) {
+        RPQTree *chain = operands[i];
+        card[i][i] = evaluate(chain);
+        for(size_t j = i + 1; j < n; j ++) {
+            chain = new RPQTree(data, chain, operands[j]);
+            card[i][j] = evaluate(chain);
+        }
+        releasePlan(chain);
+    }
+
+    return card;
+}
+
+// cheapest bushy plan for a concatenation chain by dynamic programming over its intervals, given the
+// cardinality of every interval; fills the split table and returns the cost of the plan
+double SimpleEvaluator::planChain(const std::vector<RPQTree*> &operands, const std::vector<std::vector<cardStat>> &card, std::vector<std::vector<size_t>> &split) {
+
+    size_t n = operands.size();
+    std::vector<bool> indexed;
+    std::vector<std::vector<bool>> cached;
+    chainShortcuts(operands, indexed, cached);
+
+    // cost[i][j] is the work of the best plan for operands i..j
+    std::vector<std::vector<double>> cost(n, std::vector<double>(n, 0));
+    split.assign(n, std::vector<size_t>(n, 0));
+
+    for(size_t i = 0; i < n; i ++)
+        cost[i][i] = card[i][i].noPaths;
+
+    for(size_t length = 2; length <= n; length ++) {
+        for(size_t i = 0; i + length <= n; i ++) {
+            size_t j = i + length - 1;
+            cost[i][j] = std::numeric_limits<double>::max();
+
+            for(size_t k = i; k < j; k ++) {
+                double c = splitCost(operands, card, indexed, i, k, j, cost[i][k], cost[k + 1][j]);
+                if(c < cost[i][j]) {
+                    cost[i][j] = c;
+                    split[i][j] = k;
+                }
             }
-            if(better_result == 0) break;
+
+            // a precomputed path is only copied, like a label
+            if(length == 2 && indexed[i])
+                cost[i][j] = card[i][j].noPaths;
+
+            // a sub-chain materialized by an earlier query costs nothing, whichever way it is split
+            if(cached[i][j])
+                cost[i][j] = 0;
         }
+    }
+
+    return cost[0][n - 1];
+}
+
+// cost of the plan in the split table when the sub-chains have the given cardinalities, which
+// measures a plan chosen from estimates against the true sizes
+double SimpleEvaluator::planCost(const std::vector<RPQTree*> &operands, const std::vector<std::vector<cardStat>> &card, const std::vector<std::vector<size_t>> &split) {
+
+    std::vector<bool> indexed;
+    std::vector<std::vector<bool>> cached;
+    chainShortcuts(operands, indexed, cached);
+
+    std::function<double(size_t, size_t)> cost = [&](size_t i, size_t j) -> double {
+        if(i == j) return card[i][i].noPaths;
+        if(cached[i][j]) return 0;
+        if(j == i + 1 && indexed[i]) return card[i][j].noPaths;
+        size_t k = split[i][j];
+        return splitCost(operands, card, indexed, i, k, j, cost(i, k), cost(k + 1, j));
+    };
+
+    return cost(0, operands.size() - 1);
+}
+
+// cheapest plan for the top-level concatenation chain from the estimates of its sub-chains.
+// The chosen join order is cached under the canonical text of the query.
+RPQTree* SimpleEvaluator::optimize(RPQTree *query) {
+
+    auto operands = find_leaves(query);
+    size_t n = operands.size();
+    if(n == 1) return query;
 
-        ls.erase(ls.begin() + index + 1);
-        ls[index] = best_plan;
+    auto key = PlanCache::canonical(query);
+    std::vector<uint32_t> order;
+    if(plans.get(key, graph->getVersion(), order)) {
+        size_t next = 0;
+        return replayPlan(operands, order, next, 0, n - 1);
     }
 
-    return ls[0];
+    auto start = std::chrono::steady_clock::now();
 
+    std::vector<std::vector<size_t>> split;
+    planChain(operands, estimateChain(operands), split);
+    auto plan = buildPlan(operands, split, 0, n - 1, order);
+
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    plans.put(key, graph->getVersion(), order, (uint64_t) nanos);
+
+    return plan;
 }
 
-uint32_t bestSum;
+// plan for operands i..j from the split table, recording its split points in pre-order
+RPQTree* SimpleEvaluator::buildPlan(const std::vector<RPQTree*> &operands, const std::vector<std::vector<size_t>> &split, size_t i, size_t j, std::vector<uint32_t> &order) {
 
-void SimpleEvaluator::query_optimizer2(std::vector<RPQTree*> query, uint32_t sum) {
+    if(i == j) return operands[i];
 
+    std::string data("/");
+    size_t k = split[i][j];
+    order.push_back((uint32_t) k);
+    auto left = buildPlan(operands, split, i, k, order);
+    return new RPQTree(data, left, buildPlan(operands, split, k + 1, j, order));
+}
 
-    if(query.size() > 1) {
-        std::string data("/");
-        for (auto i = 0; i < query.size() - 1; i ++) {
-            auto *c_plan = new RPQTree(data, query[i], query[i + 1]);
-            uint32_t newSum = sum + est->estimate(c_plan).noPaths;
+// plan for operands i..j from split points recorded by buildPlan()
+RPQTree* SimpleEvaluator::replayPlan(std::vector<RPQTree*> &operands, const std::vector<uint32_t> &order, size_t &next, size_t i, size_t j) {
 
-            if(newSum < bestSum) {
-                RPQTree *first = query[i];
-                RPQTree *second = query[i + 1];
+    if(i == j) return operands[i];
 
-                query[i] = c_plan;
-                query.erase(query.begin() + i + 1);
+    std::string data("/");
+    size_t k = order[next++];
+    auto left = replayPlan(operands, order, next, i, k);
+    return new RPQTree(data, left, replayPlan(operands, order, next, k + 1, j));
+}
 
-                query_optimizer2(query, newSum);
+// free the concatenations added by buildPlan(), the operands still belong to the query
+void SimpleEvaluator::releasePlan(RPQTree *plan) {
 
-                query[i] = first;
-                query.insert(query.begin() + i + 1, second);
-            }
+    if(!plan->isConcat()) return;
+
+    releasePlan(plan->left);
+    releasePlan(plan->right);
+    plan->left = nullptr;
+    plan->right = nullptr;
+    delete(plan);
+}
+
+// vertices reachable from the frontier over the path q, or that reach it when walking backward,
+// so the work done is proportional to the neighbourhood that is visited
+std::vector<uint32_t> SimpleEvaluator::reach(RPQTree *q, std::vector<uint32_t> frontier, bool backward) {
+
+    if(frontier.empty()) return frontier;
+
+    uint32_t label;
+    bool inverse;
+
+    if(q->isLeaf()) {
+        if(!parseLabel(q->data, label, inverse) || label >= graph->fwd.size()) return {};
+
+        const auto &index = (inverse != backward) ? graph->rev[label] : graph->fwd[label];
+
+        std::vector<uint32_t> next;
+        for(auto v : frontier)
+            index.appendTo(v, next);
+
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+        return next;
+    }
+
+    else if(q->isConcat()) {
+        if(backward)
+            return reach(q->left, reach(q->right, frontier, backward), backward);
+        return reach(q->right, reach(q->left, frontier, backward), backward);
+    }
+
+    else if(q->isClosure()) {
+
+        uint32_t min, max;
+        q->closureBounds(min, max);
+
+        // exactly min repetitions, then only the newly reached vertices are expanded further
+        for(uint32_t k = 0; k < min && !frontier.empty(); k ++)
+            frontier = reach(q->left, frontier, backward);
+
+        std::vector<uint32_t> result = frontier;
+        std::vector<uint32_t> delta = frontier;
+        for(uint32_t k = min; k < max && !delta.empty(); k ++) {
+            auto next = reach(q->left, delta, backward);
+
+            delta.clear();
+            std::set_difference(next.begin(), next.end(), result.begin(), result.end(), std::back_inserter(delta));
+
+            std::vector<uint32_t> merged;
+            merged.reserve(result.size() + delta.size());
+            std::merge(result.begin(), result.end(), delta.begin(), delta.end(), std::back_inserter(merged));
+            result.swap(merged);
         }
+
+        return result;
     }
-    else {
-        bestSum = sum;
-        best = query[0];
+
+    return {};
+}
+
+// walk outward from a bound source, or inward from a bound target
+cardStat SimpleEvaluator::evaluateBound(RPQTree *query, uint32_t s, uint32_t t) {
+
+    if((s != ANY_VERTEX && s >= graph->getNoVertices()) || (t != ANY_VERTEX && t >= graph->getNoVertices()))
+        return {0, 0, 0};
+
+    if(s != ANY_VERTEX) {
+        auto targets = reach(query, {s}, false);
+        if(t != ANY_VERTEX) {
+            bool found = std::binary_search(targets.begin(), targets.end(), t);
+            return found ? cardStat{1, 1, 1} : cardStat{0, 0, 0};
+        }
+        auto noTargets = (uint32_t) targets.size();
+        return {noTargets > 0 ? 1u : 0u, noTargets, noTargets};
+    }
+
+    auto sources = reach(query, {t}, true);
+    auto noSources = (uint32_t) sources.size();
+    return {noSources, noSources, noSources > 0 ? 1u : 0u};
+}
+
+// a chain of labels through the pipeline, run from the end whose prefixes the estimates expect to
+// produce fewer intermediate pairs
+cardStat SimpleEvaluator::pipeline(RPQTree *query, explainNode *node) {
+
+    bool backward = false;
+    auto operands = find_leaves(query);
+    size_t n = operands.size();
+    if(est != nullptr && n > 1) {
+        auto card = estimateChain(operands);
+        uint64_t forward = 0, reverse = 0;
+        for(size_t j = 0; j + 1 < n; j ++) forward += card[0][j].noPaths;
+        for(size_t i = 1; i < n; i ++) reverse += card[i][n - 1].noPaths;
+        backward = reverse < forward;
     }
+
+    Pipeline engine(graph);
+    cardStat result = engine.count(query, backward, buffers.get());
+
+    if(node != nullptr) {
+        node->op = backward ? "pipeline-backward" : "pipeline";
+        node->rowsRaw = engine.getRawPairs();
+        node->peakBytes = engine.getPeakBytes();
+    }
+    return result;
 }
 
-cardStat SimpleEvaluator::evaluate(RPQTree *query) {
+// bound vertices are input ids, which differ from the index ids once the graph is reordered
+cardStat SimpleEvaluator::evaluate(RPQTree *query, uint32_t s, uint32_t t) {
+
+    if(s != ANY_VERTEX || t != ANY_VERTEX)
+        return evaluateBound(query, graph->internalId(s), graph->internalId(t));
+
+    bool streamed = pipelined && Pipeline::supports(query);
 
-    auto res = std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
-    if(find_leaves(query).size() > 4) {
-        res = evaluate_aux(query_optimizer(query));
+    // without an estimator the query is evaluated in the order it was written
+    if(est == nullptr) return streamed ? pipeline(query) : countStats(query);
+
+    RPQTree *plan = optimize(query);
+
+    // large intermediate results are avoided by carrying source bitmasks through the indexes instead
+    cardStat result;
+    if(intermediateSize(plan, true) > msbfsThreshold) {
+        MultiSourceBFS engine(graph);
+        result = engine.count(query);
+    }
+    else if(streamed) {
+        result = pipeline(query);
     }
     else {
-        bestSum = UINT32_MAX;
-        query_optimizer2(find_leaves(query), 0);
-        res = evaluate_aux(best);
+        result = countStats(plan);
+    }
+
+    if(plan != query) releasePlan(plan);
+    return result;
+}
+
+// The answer goes to the sink straight from the top-level operator, so it is never materialized
+// as a whole. Plans are chosen as in evaluate(), but the operator is always the counting one: the
+// multi-source BFS and the pipeline only keep cardinalities.
+cardStat SimpleEvaluator::stream(RPQTree *query, ResultSink &sink, uint32_t s, uint32_t t) {
+
+    resultBatch out(sink, *graph);
+    cardStat result {0, 0, 0};
+
+    if(s != ANY_VERTEX || t != ANY_VERTEX) {
+        uint32_t from = graph->internalId(s);
+        uint32_t to = graph->internalId(t);
+        bool inside = (s == ANY_VERTEX || from < graph->getNoVertices()) && (t == ANY_VERTEX || to < graph->getNoVertices());
+
+        if(inside && s != ANY_VERTEX) {
+            for(auto target : reach(query, {from}, false))
+                if(t == ANY_VERTEX || target == to) {
+                    out.add(from, target);
+                    result.noPaths++;
+                }
+            result.noOut = result.noPaths > 0 ? 1 : 0;
+            result.noIn = result.noPaths;
+        } else if(inside) {
+            for(auto source : reach(query, {to}, true)) {
+                out.add(source, to);
+                result.noPaths++;
+            }
+            result.noOut = result.noPaths;
+            result.noIn = result.noPaths > 0 ? 1 : 0;
+        }
+    } else {
+        // a sink that fails throws out of the operator, the plan is released all the same
+        RPQTree *plan = est != nullptr ? optimize(query) : query;
+        try {
+            result = countStats(plan, nullptr, &out);
+        } catch (...) {
+            if(plan != query) releasePlan(plan);
+            throw;
+        }
+        if(plan != query) releasePlan(plan);
     }
 
-    return SimpleEvaluator::computeStats(res);
-}
\ No newline at end of file
+    out.flush();
+    sink.finish();
+    return result;
+}
+
+// The plan evaluate() would run for the query, with the estimate of every operator. With analyze,
+// the query is run as well and every operator records its actual cardinalities, input and output
+// rows, wall and sort time, and the memory it held.
+explainNode SimpleEvaluator::explain(RPQTree *query, uint32_t s, uint32_t t, bool analyze) {
+
+    explainNode root;
+    root.path = PlanCache::canonical(query);
+    if(est != nullptr) {
+        root.estimated = true;
+        root.estimate = est->estimate(query, s, t);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto finish = [&](const cardStat &actual) {
+        root.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        root.analyzed = true;
+        root.actual = actual;
+        uint64_t inputs = 0;
+        for(const auto &child : root.children) {
+            inputs += child.bytesOut;
+            root.peakBytes = std::max(root.peakBytes, child.peakBytes);
+        }
+        root.peakBytes = std::max(root.peakBytes, inputs);
+    };
+
+    // a bound query is a walk from its constant, not a plan
+    if(s != ANY_VERTEX || t != ANY_VERTEX) {
+        root.op = "reach";
+        root.path = (s == ANY_VERTEX ? "*" : std::to_string(s)) + "," + root.path + "," + (t == ANY_VERTEX ? "*" : std::to_string(t));
+        if(analyze) finish(evaluateBound(query, graph->internalId(s), graph->internalId(t)));
+        return root;
+    }
+
+    RPQTree *plan = est != nullptr ? optimize(query) : query;
+    bool msbfs = est != nullptr && intermediateSize(plan, true) > msbfsThreshold;
+
+    if(msbfs) {
+        root.op = "msbfs";
+        if(analyze) {
+            MultiSourceBFS engine(graph);
+            finish(engine.count(query));
+        }
+    } else if(pipelined && Pipeline::supports(query)) {
+        root.op = "pipeline";
+        if(analyze) finish(pipeline(query, &root));
+    } else if(analyze) {
+        start = std::chrono::steady_clock::now();
+        finish(countStats(plan, &root));
+    } else {
+        describe(plan, root, true);
+    }
+
+    if(plan != query) releasePlan(plan);
+    return root;
+}
+
+// the operators of a plan and their estimates, chosen the way evaluate_aux() and countStats() would
+void SimpleEvaluator::describe(RPQTree *plan, explainNode &node, bool root) {
+
+    if(!root) beginNode(plan, node);
+
+    if(plan->isLeaf()) {
+        node.op = "scan";
+        return;
+    }
+
+    if(!root && results != nullptr && results->contains(node.path, graph->getVersion())) {
+        node.op = "cached";
+        return;
+    }
+
+    node.children.reserve(2);
+    if(plan->isClosure()) {
+        node.op = root ? "closure-count" : "closure";
+        describe(plan->left, *addChild(&node), false);
+        return;
+    }
+
+    if(!root && twoHop.find(plan) != nullptr) {
+        node.op = "path-scan";
+        return;
+    }
+
+    describe(plan->left, *addChild(&node), false);
+    bool indexed = plan->right->isLeaf() || twoHop.find(plan->right) != nullptr;
+    if(indexed)
+        indexNode(plan->right, &node);
+    else
+        describe(plan->right, *addChild(&node), false);
+
+    node.op = root ? "count" : indexed ? "expand" : "join";
+}
+
+static uint64_t saturatingAdd(uint64_t a, uint64_t b) {
+    return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+// estimated number of pairs materialized by the plan, the output of the root is only counted
+uint64_t SimpleEvaluator::intermediateSize(RPQTree *plan, bool root) {
+
+    if(plan->isLeaf()) return 0;
+
+    // an unbounded fixpoint below the root materializes every round, whatever its final size
+    uint32_t min, max;
+    if(!root && plan->isClosure()) {
+        plan->closureBounds(min, max);
+        if(max == UNBOUNDED) return UINT64_MAX;
+    }
+
+    if(!root && results != nullptr && results->contains(PlanCache::canonical(plan), graph->getVersion())) return 0;
+
+    uint64_t size = root ? 0 : est->estimate(plan).noPaths;
+    if(plan->left != nullptr) size = saturatingAdd(size, intermediateSize(plan->left, false));
+    if(plan->right != nullptr && !plan->right->isLeaf()) size = saturatingAdd(size, intermediateSize(plan->right, false));
+
+    return size;
+}
@@ -2,12 +2,145 @@
 // Created by Nikolay Yakovets on 2018-01-31.
 //
 
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "SimpleGraph.h"
 
-SimpleGraph::SimpleGraph(uint32_t n)   {
+// counting sort of the edges by source, then sort and deduplicate every neighbour list in place
+void CSRIndex::build(uint32_t n, std::vector<std::pair<uint32_t,uint32_t>> &edges) {
+
+    ownedOffsets.assign(n + 1, 0);
+    ownedNeighbours.resize(edges.size());
+
+    for (const auto &edge : edges)
+        ownedOffsets[edge.first + 1]++;
+    for (uint32_t v = 0; v < n; v++)
+        ownedOffsets[v + 1] += ownedOffsets[v];
+
+    std::vector<uint32_t> fill(ownedOffsets.begin(), ownedOffsets.end() - 1);
+    for (const auto &edge : edges)
+        ownedNeighbours[fill[edge.first]++] = edge.second;
+
+    uint32_t written = 0;
+    uint32_t nonEmpty = 0;
+    for (uint32_t v = 0; v < n; v++) {
+        auto first = ownedNeighbours.begin() + ownedOffsets[v];
+        auto last = ownedNeighbours.begin() + ownedOffsets[v + 1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        if (first != last) nonEmpty++;
+
+        ownedOffsets[v] = written;
+        written = (uint32_t) (std::copy(first, last, ownedNeighbours.begin() + written) - ownedNeighbours.begin());
+    }
+    ownedOffsets[n] = written;
+
+    ownedNeighbours.resize(written);
+    ownedNeighbours.shrink_to_fit();
+
+    view(n, written, nonEmpty, ownedOffsets.data(), ownedNeighbours.data());
+}
+
+void CSRIndex::view(uint32_t n, uint32_t m, uint32_t nonEmpty, const uint32_t *offsetData, const uint32_t *neighbourData) {
+    noVertices = n;
+    noNeighbours = m;
+    noNonEmpty = nonEmpty;
+    offsets = offsetData;
+    neighbours = neighbourData;
+
+    compressed = false;
+    std::vector<uint64_t>().swap(present);
+    std::vector<uint32_t>().swap(presentRank);
+    std::vector<uint32_t>().swap(listStarts);
+    std::vector<uint8_t>().swap(packed);
+}
+
+static void writeVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while(value >= 0x80u) {
+        out.push_back((uint8_t) (value | 0x80u));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+// replace the plain arrays by the coded lists; an index whose lists take 4GB or more stays plain
+void CSRIndex::compress() {
+
+    if(compressed) return;
+
+    std::vector<uint64_t> bits((noVertices + 63) / 64, 0);
+    std::vector<uint32_t> rank(bits.size(), 0);
+    std::vector<uint32_t> starts;
+    std::vector<uint8_t> bytes;
+    starts.reserve(noNonEmpty);
+    bytes.reserve((size_t) noNeighbours + noNonEmpty);
+
+    for(uint32_t v = 0; v < noVertices; v++) {
+        if(offsets[v] == offsets[v + 1]) continue;
+        if(bytes.size() > UINT32_MAX) return;
+
+        bits[v >> 6] |= 1ull << (v & 63);
+        starts.push_back((uint32_t) bytes.size());
+        writeVarint(bytes, offsets[v + 1] - offsets[v]);
+
+        uint32_t previous = 0;
+        for(uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+            writeVarint(bytes, neighbours[i] - previous);
+            previous = neighbours[i];
+        }
+    }
+
+    uint32_t count = 0;
+    for(size_t w = 0; w < bits.size(); w++) {
+        rank[w] = count;
+        count += (uint32_t) __builtin_popcountll(bits[w]);
+    }
+    bytes.shrink_to_fit();
+
+    present.swap(bits);
+    presentRank.swap(rank);
+    listStarts.swap(starts);
+    packed.swap(bytes);
+    compressed = true;
+
+    offsets = nullptr;
+    neighbours = nullptr;
+    std::vector<uint32_t>().swap(ownedOffsets);
+    std::vector<uint32_t>().swap(ownedNeighbours);
+}
+
+// the plain arrays of the index, in either form
+void CSRIndex::decode(std::vector<uint32_t> &offsetsOut, std::vector<uint32_t> &neighboursOut) const {
+
+    offsetsOut.assign(noVertices + 1, 0);
+    neighboursOut.clear();
+    neighboursOut.reserve(noNeighbours);
+
+    for(uint32_t v = 0; v < noVertices; v++) {
+        offsetsOut[v] = (uint32_t) neighboursOut.size();
+        appendTo(v, neighboursOut);
+    }
+    offsetsOut[noVertices] = (uint32_t) neighboursOut.size();
+}
+
+size_t CSRIndex::bytes() const {
+    if(!compressed) return noVertices == 0 ? 0 : sizeof(uint32_t) * ((size_t) noVertices + 1 + noNeighbours);
+    return sizeof(uint64_t) * present.size() + sizeof(uint32_t) * (presentRank.size() + listStarts.size()) + packed.size();
+}
+
+SimpleGraph::SimpleGraph(uint32_t n) : SimpleGraph() {
     setNoVertices(n);
 }
 
+SimpleGraph::~SimpleGraph() {
+    if(mapped != nullptr) munmap(mapped, mappedSize);
+}
+
 uint32_t SimpleGraph::getNoVertices() const {
     return V;
 }
@@ -17,10 +150,7 @@ void SimpleGraph::setNoVertices(uint32_t n) {
 }
 
 uint32_t SimpleGraph::getNoEdges() const {
-    uint32_t sum = 0;
-    for (const auto & l : adj)
-        sum += l.size();
-    return sum;
+    return E;
 }
 
 // sort on the first item in the pair, then on the second (ascending order)
@@ -37,38 +167,47 @@ bool SimpleGraph::sortPairsSecond(const std::pair<uint32_t,uint32_t> &a, const s
     return false;
 }
 
+// neighbour lists are deduplicated when the indexes are built
 uint32_t SimpleGraph::getNoDistinctEdges() const {
 
     uint32_t sum = 0;
+    for (const auto &index : fwd)
+        sum += index.size();
+
+    return sum;
+}
 
-    for (auto sourceVec : adj) {
+uint32_t SimpleGraph::getNoLabels() const {
+    return L;
+}
 
-        std::sort(sourceVec.begin(), sourceVec.end(), sortPairsFirst);
+uint64_t SimpleGraph::getVersion() const {
+    return version;
+}
 
-        uint32_t prevFrom = 0;
-        uint32_t prevTo = 0;
-        bool first = true;
+// memory of the forward and reverse indexes of all labels
+size_t SimpleGraph::getIndexBytes() const {
 
-        for (const auto &edge : sourceVec) {
-            if (first || !(prevFrom == edge.first && prevTo == edge.second)) {
-                first = false;
-                sum ++;
-                prevFrom = edge.first;
-                prevTo = edge.second;
-            }
-        }
-    }
+    size_t sum = 0;
+    for (const auto &index : fwd)
+        sum += index.bytes();
+    for (const auto &index : rev)
+        sum += index.bytes();
 
     return sum;
 }
 
-uint32_t SimpleGraph::getNoLabels() const {
-    return L;
+void SimpleGraph::setSnapshotVerification(bool verify) {
+    verifySnapshots = verify;
+}
+
+void SimpleGraph::setCompression(bool compress) {
+    compressIndexes = compress;
 }
 
 void SimpleGraph::setNoLabels(uint32_t noLabels) {
     L = noLabels;
-    adj.resize(L);
+    pending.resize(L);
 }
 
 void SimpleGraph::addEdge(uint32_t from, uint32_t to, uint32_t edgeLabel) {
@@ -76,42 +215,485 @@ void SimpleGraph::addEdge(uint32_t from, uint32_t to, uint32_t edgeLabel) {
         throw std::runtime_error(std::string("Edge data out of bounds: ") +
                                          "(" + std::to_string(from) + "," + std::to_string(to) + "," +
                                          std::to_string(edgeLabel) + ")");
-    adj[edgeLabel].emplace_back(std::make_pair(from, to));
+    pending[edgeLabel].emplace_back(std::make_pair(internalId(from), internalId(to)));
+    E++;
 }
 
-void SimpleGraph::readFromContiguousFile(const std::string &fileName) {
+bool SimpleGraph::parseOrdering(const std::string &name, ordering &order) {
+    if(name == "original") order = ORIGINAL;
+    else if(name == "degree") order = DEGREE;
+    else if(name == "bfs") order = BFS;
+    else if(name == "rcm") order = RCM;
+    else return false;
+    return true;
+}
+
+bool SimpleGraph::isReordered() const {
+    return !toExternal.empty();
+}
+
+// the current ids of the vertices in their new order, over the edges of all labels in both directions
+std::vector<uint32_t> SimpleGraph::orderVertices(ordering order) const {
 
-    std::string line;
-    std::ifstream graphFile { fileName };
+    std::vector<uint32_t> degree(V, 0);
+    for (uint32_t label = 0; label < fwd.size(); label++)
+        for (uint32_t v = 0; v < V; v++)
+            degree[v] += fwd[label].degree(v) + rev[label].degree(v);
 
-    std::regex edgePat (R"((\d+)\s(\d+)\s(\d+)\s\.)"); // subject predicate object .
-    std::regex headerPat (R"((\d+),(\d+),(\d+))"); // noNodes,noEdges,noLabels
+    // most connected first, ties in id order
+    std::vector<uint32_t> byDegree;
+    for (uint32_t v = 0; v < V; v++)
+        if (degree[v] > 0) byDegree.push_back(v);
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](uint32_t a, uint32_t b) { return degree[a] > degree[b]; });
 
-    // parse the header (1st line)
-    std::getline(graphFile, line);
-    std::smatch matches;
-    if(std::regex_search(line, matches, headerPat)) {
-        uint32_t noNodes = (uint32_t) std::stoul(matches[1]);
-        uint32_t noLabels = (uint32_t) std::stoul(matches[3]);
+    std::vector<uint32_t> sequence;
+    sequence.reserve(V);
 
-        setNoVertices(noNodes);
-        setNoLabels(noLabels);
+    if (order == DEGREE) {
+        sequence = byDegree;
     } else {
+        // BFS starts every component at its largest hub and visits neighbours in id order; RCM starts
+        // at the least connected vertex, visits neighbours by ascending degree and reverses the result
+        if (order == RCM) std::reverse(byDegree.begin(), byDegree.end());
+
+        std::vector<bool> visited(V, false);
+        std::vector<uint32_t> neighbours;
+        for (auto start : byDegree) {
+            if (visited[start]) continue;
+            visited[start] = true;
+            size_t tail = sequence.size();
+            sequence.push_back(start);
+            for (; tail < sequence.size(); tail++) {
+                uint32_t v = sequence[tail];
+                neighbours.clear();
+                for (uint32_t label = 0; label < fwd.size(); label++) {
+                    fwd[label].forEach(v, [&](uint32_t n) { if (!visited[n]) { visited[n] = true; neighbours.push_back(n); } });
+                    rev[label].forEach(v, [&](uint32_t n) { if (!visited[n]) { visited[n] = true; neighbours.push_back(n); } });
+                }
+                if (order == RCM)
+                    std::stable_sort(neighbours.begin(), neighbours.end(), [&](uint32_t a, uint32_t b) { return degree[a] < degree[b]; });
+                else
+                    std::sort(neighbours.begin(), neighbours.end());
+                sequence.insert(sequence.end(), neighbours.begin(), neighbours.end());
+            }
+        }
+        if (order == RCM) std::reverse(sequence.begin(), sequence.end());
+    }
+
+    for (uint32_t v = 0; v < V; v++)
+        if (degree[v] == 0) sequence.push_back(v);
+
+    return sequence;
+}
+
+// Renumber the vertices so the ones used together sit close in the indexes, and rebuild the indexes.
+// Vertex ids passed to the graph, the evaluator and the estimator stay the input ids; they are
+// translated with internalId() and externalId().
+void SimpleGraph::reorder(ordering order) {
+
+    if (order == ORIGINAL) return;
+
+    auto sequence = orderVertices(order);
+    std::vector<uint32_t> renamed(V);
+    for (uint32_t i = 0; i < V; i++)
+        renamed[sequence[i]] = i;
+
+    for (uint32_t label = 0; label < L; label++) {
+        auto &edges = pending[label];
+        for (auto &edge : edges)
+            edge = std::make_pair(renamed[edge.first], renamed[edge.second]);
+        if (label < fwd.size()) {
+            for (uint32_t v = 0; v < fwd[label].noVertices; v++)
+                fwd[label].forEach(v, [&](uint32_t n) { edges.emplace_back(renamed[v], renamed[n]); });
+            fwd[label] = CSRIndex();
+            rev[label] = CSRIndex();
+        }
+    }
+
+    // the new numbering is composed with the one before it
+    if (toExternal.empty()) {
+        toExternal = sequence;
+    } else {
+        std::vector<uint32_t> composed(V);
+        for (uint32_t i = 0; i < V; i++)
+            composed[i] = toExternal[sequence[i]];
+        toExternal.swap(composed);
+    }
+    toInternal.assign(V, 0);
+    for (uint32_t i = 0; i < V; i++)
+        toInternal[toExternal[i]] = i;
+
+    buildIndexes();
+}
+
+// (re)build the forward and reverse index of every label, merging the pending edges into them
+void SimpleGraph::buildIndexes() {
+
+    fwd.resize(L);
+    rev.resize(L);
+
+    auto noThreads = std::min(std::max(1u, std::thread::hardware_concurrency()), L);
+    std::atomic<uint32_t> next {0};
+
+    auto worker = [&]() {
+        for (uint32_t label = next++; label < L; label = next++)
+            buildIndex(label);
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < noThreads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers)
+        w.join();
+
+    version++;
+}
+
+void SimpleGraph::buildIndex(uint32_t label) {
+
+    auto &edges = pending[label];
+
+    // keep the edges that are already indexed
+    for (uint32_t v = 0; v < fwd[label].noVertices; v++)
+        fwd[label].forEach(v, [&](uint32_t n) { edges.emplace_back(v, n); });
+
+    fwd[label].build(V, edges);
+
+    for (auto &edge : edges)
+        std::swap(edge.first, edge.second);
+    rev[label].build(V, edges);
+
+    std::vector<std::pair<uint32_t,uint32_t>>().swap(edges);
+
+    if (compressIndexes) {
+        fwd[label].compress();
+        rev[label].compress();
+    }
+}
+
+// scan an unsigned integer at p, false if there is none
+static bool scanNumber(const char *&p, const char *end, uint32_t &value) {
+    if(p == end || *p < '0' || *p > '9') return false;
+    uint64_t v = 0;
+    while(p != end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t) (*p - '0');
+        if(v > UINT32_MAX) return false;
+        p++;
+    }
+    value = (uint32_t) v;
+    return true;
+}
+
+static void skipBlanks(const char *&p, const char *end) {
+    while(p != end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+}
+
+struct edgeChunk {
+    const char *begin;
+    const char *end;
+    std::vector<std::vector<std::pair<uint32_t,uint32_t>>> edges; // per label
+    std::string error;
+};
+
+// parse the "subject predicate object ." lines of one chunk, skipping the lines that do not match
+static void parseChunk(edgeChunk &chunk, uint32_t V, uint32_t L) {
+
+    chunk.edges.resize(L);
+
+    const char *p = chunk.begin;
+    while(p < chunk.end) {
+        const char *eol = (const char *) memchr(p, '\n', chunk.end - p);
+        if(eol == nullptr) eol = chunk.end;
+
+        uint32_t subject = 0, predicate = 0, object = 0;
+        const char *q = p;
+        skipBlanks(q, eol);
+        bool match = scanNumber(q, eol, subject);
+        skipBlanks(q, eol);
+        match = match && scanNumber(q, eol, predicate);
+        skipBlanks(q, eol);
+        match = match && scanNumber(q, eol, object);
+        skipBlanks(q, eol);
+        match = match && q != eol && *q == '.';
+
+        if(match) {
+            if(subject >= V || object >= V || predicate >= L) {
+                chunk.error = std::string("Edge data out of bounds: ") +
+                              "(" + std::to_string(subject) + "," + std::to_string(object) + "," +
+                              std::to_string(predicate) + ")";
+                return;
+            }
+            chunk.edges[predicate].emplace_back(subject, object);
+        }
+
+        p = eol + 1;
+    }
+}
+
+void SimpleGraph::readFromContiguousFile(const std::string &fileName) {
+
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error(std::string("Unable to open graph file: ") + fileName);
+
+    struct stat st {};
+    fstat(fd, &st);
+    auto size = (size_t) st.st_size;
+
+    const char *data = nullptr;
+    if(size > 0) {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(std::string("Unable to map graph file: ") + fileName);
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const char *) mapped;
+    }
+    close(fd);
+
+    const char *end = data + size;
+
+    // parse the header (1st line): noNodes,noEdges,noLabels
+    const char *p = data;
+    const char *eol = size > 0 ? (const char *) memchr(data, '\n', size) : nullptr;
+    if(eol == nullptr) eol = end;
+
+    uint32_t noNodes, noEdges, noLabels;
+    skipBlanks(p, eol);
+    bool header = scanNumber(p, eol, noNodes) && p != eol && *p++ == ',' &&
+                  scanNumber(p, eol, noEdges) && p != eol && *p++ == ',' &&
+                  scanNumber(p, eol, noLabels);
+    if(!header) {
+        if(data != nullptr) munmap((void *) data, size);
         throw std::runtime_error(std::string("Invalid graph header!"));
     }
 
-    // parse edge data
-    while(std::getline(graphFile, line)) {
+    setNoVertices(noNodes);
+    setNoLabels(noLabels);
 
-        if(std::regex_search(line, matches, edgePat)) {
-            uint32_t subject = (uint32_t) std::stoul(matches[1]);
-            uint32_t predicate = (uint32_t) std::stoul(matches[2]);
-            uint32_t object = (uint32_t) std::stoul(matches[3]);
+    // split the edge data into newline-aligned chunks, one per thread
+    const char *body = eol == end ? end : eol + 1;
+    auto noThreads = std::max(1u, std::thread::hardware_concurrency());
+    noThreads = (uint32_t) std::min<size_t>(noThreads, (end - body) / (1 << 16) + 1);
 
-            addEdge(subject, object, predicate);
+    std::vector<edgeChunk> chunks(noThreads);
+    const char *chunkBegin = body;
+    for(uint32_t i = 0; i < noThreads; i++) {
+        const char *chunkEnd = i + 1 == noThreads ? end : body + (end - body) * (i + 1) / noThreads;
+        if(chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+        while(chunkEnd != end && *(chunkEnd - 1) != '\n') chunkEnd++;
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    std::vector<std::thread> workers;
+    for(uint32_t i = 1; i < noThreads; i++)
+        workers.emplace_back(parseChunk, std::ref(chunks[i]), V, L);
+    parseChunk(chunks[0], V, L);
+    for(auto &worker : workers)
+        worker.join();
+
+    if(data != nullptr) munmap((void *) data, size);
+
+    for(const auto &chunk : chunks)
+        if(!chunk.error.empty())
+            throw std::runtime_error(chunk.error);
+
+    // merge the per-thread edge buffers into the label lists
+    for(uint32_t label = 0; label < L; label++) {
+        size_t total = pending[label].size();
+        for(const auto &chunk : chunks)
+            total += chunk.edges[label].size();
+        pending[label].reserve(total);
+
+        for(auto &chunk : chunks) {
+            pending[label].insert(pending[label].end(), chunk.edges[label].begin(), chunk.edges[label].end());
+            E += (uint32_t) chunk.edges[label].size();
+            std::vector<std::pair<uint32_t,uint32_t>>().swap(chunk.edges[label]);
         }
     }
 
-    graphFile.close();
+    buildIndexes();
+
+}
+
+// Snapshot layout (native byte order, every section 4-byte aligned):
+//   snapshotHeader
+//   per label: snapshotLabel
+//   per label: fwd offsets (V+1), fwd neighbours, rev offsets (V+1), rev neighbours
+static const char snapshotMagic[8] = {'Q', 'S', 'G', 'R', 'A', 'P', 'H', '\0'};
+static const uint32_t snapshotVersion = 1;
+
+struct snapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t noVertices;
+    uint32_t noEdges;
+    uint32_t noLabels;
+};
 
-}
\ No newline at end of file
+struct snapshotLabel {
+    uint32_t noFwdNeighbours;
+    uint32_t noFwdNonEmpty;
+    uint32_t noRevNeighbours;
+    uint32_t noRevNonEmpty;
+};
+
+bool SimpleGraph::isSnapshot(const std::string &fileName) {
+
+    std::ifstream file { fileName, std::ios::binary };
+    char magic[sizeof(snapshotMagic)] = {};
+    file.read(magic, sizeof(magic));
+
+    return file.gcount() == sizeof(magic) && memcmp(magic, snapshotMagic, sizeof(magic)) == 0;
+}
+
+void SimpleGraph::writeSnapshot(const std::string &fileName) const {
+
+    bool indexed = fwd.size() == L && rev.size() == L;
+    for(uint32_t label = 0; indexed && label < L; label++)
+        indexed = pending[label].empty() && fwd[label].noVertices == V && rev[label].noVertices == V;
+    if(!indexed)
+        throw std::runtime_error(std::string("Cannot snapshot a graph with unindexed edges!"));
+    if(isReordered())
+        throw std::runtime_error(std::string("Cannot snapshot a reordered graph!"));
+
+    std::ofstream file { fileName, std::ios::binary | std::ios::trunc };
+    if(!file)
+        throw std::runtime_error(std::string("Unable to write graph snapshot: ") + fileName);
+
+    snapshotHeader header {};
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.noVertices = V;
+    header.noEdges = E;
+    header.noLabels = L;
+    file.write((const char *) &header, sizeof(header));
+
+    for(uint32_t label = 0; label < L; label++) {
+        snapshotLabel entry { fwd[label].size(), fwd[label].noNonEmpty, rev[label].size(), rev[label].noNonEmpty };
+        file.write((const char *) &entry, sizeof(entry));
+    }
+
+    // snapshots hold the plain arrays, so they can be mapped and used as they are
+    std::vector<uint32_t> offsets, neighbours;
+    for(uint32_t label = 0; label < L; label++) {
+        for(const auto *index : {&fwd[label], &rev[label]}) {
+            if(index->compressed) {
+                index->decode(offsets, neighbours);
+                file.write((const char *) offsets.data(), sizeof(uint32_t) * (V + 1));
+                file.write((const char *) neighbours.data(), sizeof(uint32_t) * neighbours.size());
+                continue;
+            }
+            file.write((const char *) index->offsets, sizeof(uint32_t) * (V + 1));
+            file.write((const char *) index->neighbours, sizeof(uint32_t) * index->size());
+        }
+    }
+
+    if(!file)
+        throw std::runtime_error(std::string("Unable to write graph snapshot: ") + fileName);
+}
+
+// an offsets array that starts at 0 and ends at the neighbour count; reads two words, so opening stays lazy
+static bool sectionBounds(const uint32_t *offsets, uint64_t noVertices, uint64_t noNeighbours) {
+    return offsets[0] == 0 && offsets[noVertices] == noNeighbours;
+}
+
+// offsets that never decrease, followed by neighbours that are all vertices of the graph; reads the whole section
+static bool validSection(const uint32_t *offsets, uint64_t noVertices, uint64_t noNeighbours) {
+
+    for(uint64_t v = 0; v < noVertices; v++)
+        if(offsets[v] > offsets[v + 1]) return false;
+
+    const uint32_t *neighbours = offsets + noVertices + 1;
+    for(uint64_t i = 0; i < noNeighbours; i++)
+        if(neighbours[i] >= noVertices) return false;
+    return true;
+}
+
+// map the snapshot and point the indexes into it, the OS loads the pages on first use
+void SimpleGraph::readFromSnapshot(const std::string &fileName) {
+
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error(std::string("Unable to open graph snapshot: ") + fileName);
+
+    struct stat st {};
+    fstat(fd, &st);
+    auto size = (size_t) st.st_size;
+
+    void *data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(data == MAP_FAILED)
+        throw std::runtime_error(std::string("Unable to map graph snapshot: ") + fileName);
+
+    auto invalid = [&]() {
+        munmap(data, size);
+        return std::runtime_error(std::string("Invalid graph snapshot!"));
+    };
+
+    const auto *header = (const snapshotHeader *) data;
+    if(size < sizeof(snapshotHeader) || memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0)
+        throw invalid();
+    if(header->version != snapshotVersion)
+        throw invalid();
+
+    uint64_t noVertices = header->noVertices;
+    uint64_t noLabels = header->noLabels;
+    const auto *labels = (const snapshotLabel *) (header + 1);
+
+    uint64_t expected = sizeof(snapshotHeader) + noLabels * sizeof(snapshotLabel);
+    if(size < expected)
+        throw invalid();
+    for(uint64_t label = 0; label < noLabels; label++)
+        expected += sizeof(uint32_t) * (2 * (noVertices + 1) + labels[label].noFwdNeighbours + labels[label].noRevNeighbours);
+    if(size != expected)
+        throw invalid();
+
+    // the indexes are read without bounds checks: the layout of every section is checked here, and its
+    // contents only when asked to or when compressing, which reads the whole file anyway
+    const auto *section = (const uint32_t *) (labels + noLabels);
+    for(uint64_t label = 0; label < noLabels; label++) {
+        for(uint64_t noNeighbours : {labels[label].noFwdNeighbours, labels[label].noRevNeighbours}) {
+            if(!sectionBounds(section, noVertices, noNeighbours))
+                throw invalid();
+            if((verifySnapshots || compressIndexes) && !validSection(section, noVertices, noNeighbours))
+                throw invalid();
+            section += noVertices + 1 + noNeighbours;
+        }
+    }
+
+    if(mapped != nullptr) munmap(mapped, mappedSize);
+    mapped = data;
+    mappedSize = size;
+
+    setNoVertices(header->noVertices);
+    pending.clear();
+    setNoLabels(header->noLabels);
+    E = header->noEdges;
+    toInternal.clear();
+    toExternal.clear();
+
+    fwd.clear();
+    rev.clear();
+    fwd.resize(L);
+    rev.resize(L);
+
+    section = (const uint32_t *) (labels + L);
+    for(uint32_t label = 0; label < L; label++) {
+        fwd[label].view(V, labels[label].noFwdNeighbours, labels[label].noFwdNonEmpty, section, section + V + 1);
+        section += V + 1 + labels[label].noFwdNeighbours;
+        rev[label].view(V, labels[label].noRevNeighbours, labels[label].noRevNonEmpty, section, section + V + 1);
+        section += V + 1 + labels[label].noRevNeighbours;
+
+        if(compressIndexes) {
+            fwd[label].compress();
+            rev[label].compress();
+        }
+    }
+
+    version++;
+}
@@ -0,0 +1,125 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t noThreads) : pending(0), next(0), stopping(false) {
+
+    if(noThreads == 0) noThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(uint32_t i = 0; i < noThreads; i++)
+        queues.emplace_back(new queue());
+    for(uint32_t i = 0; i < noThreads; i++)
+        workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+
+    {
+        std::unique_lock<std::mutex> guard(sleep);
+        stopping = true;
+    }
+    available.notify_all();
+
+    for(auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::push(uint32_t target, std::function<void()> task) {
+
+    pending++;
+    {
+        std::unique_lock<std::mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::unique_lock<std::mutex> guard(sleep);
+    }
+    available.notify_one();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    push(next++ % size(), std::move(task));
+}
+
+// block until every submitted task has finished
+void ThreadPool::wait() {
+
+    std::unique_lock<std::mutex> guard(sleep);
+    idle.wait(guard, [this]() { return pending == 0; });
+}
+
+uint32_t ThreadPool::size() const {
+    return (uint32_t) workers.size();
+}
+
+// run one task, own deque first (newest), then steal from the others (oldest); false if none was found
+bool ThreadPool::runOne(uint32_t self) {
+
+    std::function<void()> task;
+
+    for(uint32_t i = 0; i < size() && !task; i++) {
+        uint32_t victim = (self + i) % size();
+        std::unique_lock<std::mutex> guard(queues[victim]->lock);
+        if(queues[victim]->tasks.empty()) continue;
+
+        if(i == 0) {
+            task = std::move(queues[victim]->tasks.back());
+            queues[victim]->tasks.pop_back();
+        } else {
+            task = std::move(queues[victim]->tasks.front());
+            queues[victim]->tasks.pop_front();
+        }
+    }
+
+    if(!task) return false;
+
+    task();
+
+    if(--pending == 0) {
+        std::unique_lock<std::mutex> guard(sleep);
+        idle.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::work(uint32_t self) {
+
+    while(true) {
+        if(runOne(self)) continue;
+
+        std::unique_lock<std::mutex> guard(sleep);
+        if(stopping) return;
+
+        // re-check under the lock so a concurrent push() cannot be missed
+        bool queued = false;
+        for(auto &q : queues) {
+            std::unique_lock<std::mutex> queueGuard(q->lock);
+            queued = queued || !q->tasks.empty();
+        }
+        if(!queued) available.wait(guard);
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t noTasks, const std::function<void(uint32_t)> &body) {
+
+    if(noTasks == 0) return;
+    if(noTasks == 1 || size() == 0) {
+        for(uint32_t i = 0; i < noTasks; i++) body(i);
+        return;
+    }
+
+    auto remaining = std::make_shared<std::atomic<uint32_t>>(noTasks);
+    uint32_t first = next++;
+    for(uint32_t i = 1; i < noTasks; i++) {
+        push((first + i) % size(), [&body, remaining, i]() {
+            body(i);
+            (*remaining)--;
+        });
+    }
+
+    body(0);
+    (*remaining)--;
+
+    // help with any queued work until the forked tasks are done
+    while(*remaining > 0) {
+        if(!runOne(first % size())) std::this_thread::yield();
+    }
+}
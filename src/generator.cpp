@@ -0,0 +1,99 @@
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <GraphGenerator.h>
+
+void usage() {
+    std::cout << "Usage: qsgen <graphFile> <queriesFile> [--seed N] [--vertices N] [--edges N] [--labels N]" << std::endl;
+    std::cout << "             [--distribution uniform|zipf:S|powerlaw:GAMMA[,...]] [--label-skew S]" << std::endl;
+    std::cout << "             [--queries N] [--chain MIN:MAX] [--bound SHARE] [--closure SHARE] [--inverse SHARE]" << std::endl;
+    std::cout << "A file name of - writes to the standard output." << std::endl;
+}
+
+// write to the named file, or to stdout for "-"
+bool writeTo(const std::string &fileName, const std::function<void(std::ostream &)> &body) {
+
+    if(fileName == "-") {
+        body(std::cout);
+        std::cout.flush();
+        return true;
+    }
+
+    std::ofstream out(fileName, std::ios::binary);
+    if(!out) {
+        std::cerr << "Unable to open output file: " << fileName << std::endl;
+        return false;
+    }
+    body(out);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+
+    if(argc < 3) {
+        usage();
+        return 0;
+    }
+
+    std::string graphFile {argv[1]};
+    std::string queriesFile {argv[2]};
+
+    generatorConfig config;
+    try {
+        for(int i = 3; i < argc; i++) {
+            std::string arg {argv[i]};
+            std::string value;
+            auto equals = arg.find('=');
+            if(equals != std::string::npos) {
+                value = arg.substr(equals + 1);
+                arg = arg.substr(0, equals);
+            } else if(i + 1 < argc) {
+                value = argv[++i];
+            }
+
+            if(arg == "--seed") config.seed = std::stoull(value);
+            else if(arg == "--vertices") config.noVertices = (uint32_t) std::stoul(value);
+            else if(arg == "--edges") config.noEdges = std::stoull(value);
+            else if(arg == "--labels") config.noLabels = (uint32_t) std::stoul(value);
+            else if(arg == "--label-skew") config.labelSkew = std::stod(value);
+            else if(arg == "--queries") config.noQueries = (uint32_t) std::stoul(value);
+            else if(arg == "--bound") config.boundShare = std::stod(value);
+            else if(arg == "--closure") config.closureShare = std::stod(value);
+            else if(arg == "--inverse") config.inverseShare = std::stod(value);
+            else if(arg == "--chain") {
+                auto colon = value.find(':');
+                config.minChain = (uint32_t) std::stoul(value.substr(0, colon));
+                config.maxChain = colon == std::string::npos ? config.minChain : (uint32_t) std::stoul(value.substr(colon + 1));
+            }
+            else if(arg == "--distribution") {
+                config.distributions.clear();
+                size_t begin = 0;
+                while(begin <= value.size()) {
+                    auto comma = value.find(',', begin);
+                    if(comma == std::string::npos) comma = value.size();
+                    labelDistribution distribution;
+                    if(!labelDistribution::parse(value.substr(begin, comma - begin), distribution)) {
+                        std::cerr << "Invalid degree distribution: " << value.substr(begin, comma - begin) << std::endl;
+                        return 1;
+                    }
+                    config.distributions.push_back(distribution);
+                    begin = comma + 1;
+                }
+            }
+            else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                usage();
+                return 1;
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+
+    GraphGenerator generator(config);
+    if(!writeTo(graphFile, [&](std::ostream &out) { generator.writeGraph(out); })) return 1;
+    if(!writeTo(queriesFile, [&](std::ostream &out) { generator.writeQueries(out); })) return 1;
+
+    return 0;
+}
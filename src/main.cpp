@@ -1,9 +1,11 @@
 #include <iostream>
 #include <chrono>
+#include <cmath>
 #include <SimpleGraph.h>
 #include <Estimator.h>
 #include <SimpleEstimator.h>
 #include <SimpleEvaluator.h>
+#include <ThreadPool.h>
 
 
 struct query {
@@ -11,9 +13,43 @@ struct query {
     std::string path;
     std::string t;
 
+    // the vertices s and t stand for after bind(), ANY_VERTEX for '*'
+    uint32_t source = ANY_VERTEX;
+    uint32_t target = ANY_VERTEX;
+
     void print() {
         std::cout << s << ", " << path << ", " << t << std::endl;
     }
+
+    // constant at the given end of the query, false unless it is '*' or a vertex of the graph
+    static bool vertex(const std::string &end, uint32_t noVertices, uint32_t &v) {
+        if(end == "*") {
+            v = ANY_VERTEX;
+            return true;
+        }
+
+        uint64_t value = 0;
+        for(char c : end) {
+            if(!std::isdigit((unsigned char) c)) return false;
+            value = value * 10 + (uint64_t) (c - '0');
+            if(value >= noVertices) return false;
+        }
+        v = (uint32_t) value;
+        return !end.empty();
+    }
+
+    // resolve both ends against the graph, false with an error if either is malformed or out of range
+    bool bind(uint32_t noVertices) {
+        if(!vertex(s, noVertices, source)) {
+            std::cerr << "Invalid query constant: " << s << std::endl;
+            return false;
+        }
+        if(!vertex(t, noVertices, target)) {
+            std::cerr << "Invalid query constant: " << t << std::endl;
+            return false;
+        }
+        return true;
+    }
 };
 
 std::vector<query> parseQueries(std::string &fileName) {
@@ -23,7 +59,7 @@ std::vector<query> parseQueries(std::string &fileName) {
     std::string line;
     std::ifstream graphFile { fileName };
 
-    std::regex edgePat (R"((.+),(.+),(.+))");
+    std::regex edgePat (R"(([^,]+),(.+),([^,]+))"); // the path may itself contain commas, e.g. 2+{1,3}
 
     while(std::getline(graphFile, line)) {
         std::smatch matches;
@@ -45,16 +81,319 @@ std::vector<query> parseQueries(std::string &fileName) {
     return queries;
 }
 
-int estimatorBench(std::string &graphFile, std::string &queriesFile) {
+// how a graph is loaded and how its indexes are laid out
+struct graphOptions {
+    bool compress = false; // indexes are compressed once built or mapped from a snapshot
+    bool verify = false;   // a snapshot is checked in full when it is opened, not just its layout
+    SimpleGraph::ordering order = SimpleGraph::ORIGINAL;
+};
+
+// where the answers of the queries are written, nowhere without a prefix
+struct outputOptions {
+    std::string prefix; // the answer of the n-th query goes to <prefix>.<n>
+    FileSink::format format = FileSink::TEXT;
+};
+
+// read either a text graph or a binary snapshot, detected from the file contents
+void readGraph(std::shared_ptr<SimpleGraph> &g, std::string &graphFile, const graphOptions &options = {}) {
+
+    g->setCompression(options.compress);
+    g->setSnapshotVerification(options.verify);
+    if(SimpleGraph::isSnapshot(graphFile))
+        g->readFromSnapshot(graphFile);
+    else
+        g->readFromContiguousFile(graphFile);
+
+    if(options.order != SimpleGraph::ORIGINAL) {
+        auto start = std::chrono::steady_clock::now();
+        g->reorder(options.order);
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Time to reorder the vertices: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    }
+}
+
+// nearest-rank percentile of the values, p in [0, 1]
+double percentile(std::vector<double> values, double p) {
+    if(values.empty()) return 0;
+    auto rank = (size_t) std::ceil(p * values.size());
+    auto nth = values.begin() + (rank > 0 ? rank - 1 : 0);
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+// factor by which an estimate is off in either direction, empty results counting as one
+double qError(uint32_t estimate, uint32_t actual) {
+    double e = std::max(estimate, 1u);
+    double a = std::max(actual, 1u);
+    return std::max(e / a, a / e);
+}
+
+// the query as a quoted CSV or JSON string
+std::string quoted(const query &q) {
+    std::string text = q.s + "," + q.path + "," + q.t;
+    std::string out = "\"";
+    for(auto c : text) {
+        if(c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// accuracy and speed of the estimator on one query
+struct estimatorRun {
+    query q;
+    cardStat estimate {0, 0, 0};
+    cardStat actual {0, 0, 0};
+    double qErrors[3] {1, 1, 1}; // noOut, noPaths, noIn
+    double latency = 0;          // median over the timed iterations, microseconds
+    bool planned = false;        // the query is a chain the optimizer orders
+    double planCost = 0;         // the chosen plan under the true cardinalities
+    double optimalCost = 0;      // the best plan under the true cardinalities
+};
+
+// Every query is estimated warmup times, then timed over the given iterations, and compared to the
+// exact result. For unbound chains, the plan chosen from the estimates is costed with the true
+// sub-chain cardinalities and compared to the best plan for those. Results go to stdout as CSV (a
+// table of queries, a blank line and a table of percentiles) or as one JSON object.
+int estimatorBench(std::string &graphFile, std::string &queriesFile, uint32_t sketchMB, const std::string &format, uint32_t warmup, uint32_t iterations) {
+
+    auto g = std::make_shared<SimpleGraph>();
+    try {
+        readGraph(g, graphFile);
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 0;
+    }
+
+    auto est = std::make_shared<SimpleEstimator>(g);
+    est->setSketchBudget((size_t) sketchMB << 20);
+    auto start = std::chrono::steady_clock::now();
+    est->prepare();
+    auto end = std::chrono::steady_clock::now();
+    double prepareTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // exact results come from an evaluator without shortcuts, so plan costs only depend on cardinalities
+    auto ev = std::make_unique<SimpleEvaluator>(g);
+    ev->attachEstimator(est);
+    ev->prepare();
+
+    std::vector<estimatorRun> runs;
+    std::vector<double> latencies;
+
+    for(auto &query : parseQueries(queriesFile)) {
+        if(!query.bind(g->getNoVertices())) continue;
+        RPQTree *queryTree = RPQTree::strToTree(query.path);
+        if(queryTree == nullptr) continue;
+
+        estimatorRun run;
+        run.q = query;
+        auto s = query.source;
+        auto t = query.target;
+
+        for(uint32_t i = 0; i < warmup; i ++)
+            est->estimate(queryTree, s, t);
+
+        std::vector<double> times;
+        for(uint32_t i = 0; i < iterations; i ++) {
+            start = std::chrono::steady_clock::now();
+            run.estimate = est->estimate(queryTree, s, t);
+            end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+        if(iterations == 0) run.estimate = est->estimate(queryTree, s, t);
+        run.latency = percentile(times, 0.5);
+        latencies.insert(latencies.end(), times.begin(), times.end());
+
+        run.actual = ev->evaluate(queryTree, s, t);
+        run.qErrors[0] = qError(run.estimate.noOut, run.actual.noOut);
+        run.qErrors[1] = qError(run.estimate.noPaths, run.actual.noPaths);
+        run.qErrors[2] = qError(run.estimate.noIn, run.actual.noIn);
+
+        auto operands = ev->find_leaves(queryTree);
+        if(s == ANY_VERTEX && t == ANY_VERTEX && operands.size() > 1) {
+            std::vector<std::vector<size_t>> chosen, optimal;
+            ev->planChain(operands, ev->estimateChain(operands), chosen);
+
+            auto exact = ev->exactChain(operands);
+            run.planned = true;
+            run.optimalCost = ev->planChain(operands, exact, optimal);
+            run.planCost = ev->planCost(operands, exact, chosen);
+        }
+
+        runs.push_back(run);
+        delete(queryTree);
+    }
+
+    // distributions over the workload
+    std::vector<std::string> metrics {"qerror_noOut", "qerror_noPaths", "qerror_noIn", "plan_gap", "latency_us"};
+    std::vector<std::vector<double>> values(metrics.size());
+    for(auto &run : runs) {
+        for(int f = 0; f < 3; f ++)
+            values[f].push_back(run.qErrors[f]);
+        if(run.planned) values[3].push_back(run.planCost / std::max(run.optimalCost, 1.0));
+    }
+    values[4] = latencies;
+
+    std::vector<double> ranks {0.5, 0.9, 0.99, 1.0};
+    std::vector<std::string> rankNames {"p50", "p90", "p99", "max"};
+
+    if(format == "json") {
+        std::cout << "{\"graph\": \"" << graphFile << "\", \"queries_file\": \"" << queriesFile << "\", \"prepare_ms\": " << prepareTime
+                  << ", \"warmup\": " << warmup << ", \"iterations\": " << iterations << ",\n \"queries\": [";
+        for(size_t i = 0; i < runs.size(); i ++) {
+            auto &run = runs[i];
+            std::cout << (i > 0 ? "," : "") << "\n  {\"query\": " << quoted(run.q)
+                      << ", \"estimate\": [" << run.estimate.noOut << ", " << run.estimate.noPaths << ", " << run.estimate.noIn << "]"
+                      << ", \"actual\": [" << run.actual.noOut << ", " << run.actual.noPaths << ", " << run.actual.noIn << "]"
+                      << ", \"qerror\": [" << run.qErrors[0] << ", " << run.qErrors[1] << ", " << run.qErrors[2] << "]"
+                      << ", \"latency_us\": " << run.latency;
+            if(run.planned)
+                std::cout << ", \"plan_cost\": " << run.planCost << ", \"optimal_cost\": " << run.optimalCost
+                          << ", \"plan_gap\": " << run.planCost / std::max(run.optimalCost, 1.0);
+            std::cout << "}";
+        }
+        std::cout << "\n ],\n \"summary\": {";
+        for(size_t m = 0; m < metrics.size(); m ++) {
+            std::cout << (m > 0 ? "," : "") << "\n  \"" << metrics[m] << "\": {\"count\": " << values[m].size();
+            for(size_t r = 0; r < ranks.size(); r ++)
+                std::cout << ", \"" << rankNames[r] << "\": " << percentile(values[m], ranks[r]);
+            std::cout << "}";
+        }
+        std::cout << "\n }\n}" << std::endl;
+        return 0;
+    }
+
+    std::cout << "query,est_noOut,est_noPaths,est_noIn,noOut,noPaths,noIn,qerror_noOut,qerror_noPaths,qerror_noIn,latency_us,plan_cost,optimal_cost,plan_gap" << std::endl;
+    for(auto &run : runs) {
+        std::cout << quoted(run.q) << "," << run.estimate.noOut << "," << run.estimate.noPaths << "," << run.estimate.noIn
+                  << "," << run.actual.noOut << "," << run.actual.noPaths << "," << run.actual.noIn
+                  << "," << run.qErrors[0] << "," << run.qErrors[1] << "," << run.qErrors[2] << "," << run.latency;
+        if(run.planned)
+            std::cout << "," << run.planCost << "," << run.optimalCost << "," << run.planCost / std::max(run.optimalCost, 1.0);
+        else
+            std::cout << ",,,";
+        std::cout << std::endl;
+    }
+
+    std::cout << "\nmetric,count,p50,p90,p99,max" << std::endl;
+    for(size_t m = 0; m < metrics.size(); m ++) {
+        std::cout << metrics[m] << "," << values[m].size();
+        for(auto rank : ranks)
+            std::cout << "," << percentile(values[m], rank);
+        std::cout << std::endl;
+    }
+    std::cout << "prepare_ms,1," << prepareTime << "," << prepareTime << "," << prepareTime << "," << prepareTime << std::endl;
+
+    return 0;
+}
+
+void printPlanCache(PlanCache &plans) {
+    std::cout << "\nPlan cache: " << plans.getHits() << " hits, " << plans.getMisses() << " misses, "
+              << plans.getPlanningTime() << " ms spent planning the misses" << std::endl;
+}
+
+// sub-path results shared by the queries of a workload, unless the budget is 0
+std::shared_ptr<ResultCache> attachResultCache(std::unique_ptr<SimpleEvaluator> &ev, uint32_t cacheMB) {
+    if(cacheMB == 0) return nullptr;
+    auto results = std::make_shared<ResultCache>((size_t) cacheMB << 20);
+    ev->attachResultCache(results);
+    return results;
+}
+
+// buffers for intermediate relations reused across operators and queries, unless the budget is 0
+std::shared_ptr<RelationPool> attachRelationPool(std::unique_ptr<SimpleEvaluator> &ev, uint32_t bufferMB) {
+    if(bufferMB == 0) return nullptr;
+    auto buffers = std::make_shared<RelationPool>((size_t) bufferMB << 20);
+    ev->attachRelationPool(buffers);
+    return buffers;
+}
+
+void printRelationPool(std::shared_ptr<RelationPool> &buffers) {
+    if(buffers == nullptr) return;
+    std::cout << "Buffer pool: " << buffers->getReused() << " buffers reused, " << buffers->getAllocated() << " allocated, "
+              << buffers->getDropped() << " dropped, " << buffers->getBytesPooled() << " bytes pooled" << std::endl;
+}
+
+void printResultCache(std::shared_ptr<ResultCache> &results) {
+    if(results == nullptr) return;
+    std::cout << "Result cache: " << results->getHits() << " hits, " << results->getMisses() << " misses ("
+              << 100 * results->getHitRate() << "% hit rate), " << results->getBytesUsed() << " bytes used, "
+              << results->getEvictions() << " evictions" << std::endl;
+}
+
+// precompute the two-label paths that occur most often in the workload's chains, within pathMB
+void configurePathIndex(std::unique_ptr<SimpleEvaluator> &ev, std::string &queriesFile, uint32_t pathMB) {
+
+    if(pathMB == 0) return;
+
+    std::unordered_map<std::string, uint32_t> counts;
+    for(auto &query : parseQueries(queriesFile)) {
+        RPQTree *queryTree = RPQTree::strToTree(query.path);
+        if(queryTree == nullptr) continue;
+
+        auto operands = ev->find_leaves(queryTree);
+        for(size_t i = 0; i + 1 < operands.size(); i ++) {
+            if(operands[i]->isLeaf() && operands[i + 1]->isLeaf())
+                counts[operands[i]->data + "/" + operands[i + 1]->data]++;
+        }
+        delete(queryTree);
+    }
+
+    std::vector<std::pair<uint32_t, std::string>> ranked;
+    for(auto &count : counts)
+        ranked.emplace_back(count.second, count.first);
+    std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint32_t, std::string> &a, const std::pair<uint32_t, std::string> &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<std::string> frequent;
+    for(auto &path : ranked)
+        frequent.push_back(path.second);
+
+    ev->configurePathIndex(frequent, (size_t) pathMB << 20);
+}
+
+void printPathIndex(std::unique_ptr<SimpleEvaluator> &ev) {
+    auto &paths = ev->getPathIndex();
+    if(paths.size() == 0) return;
+    std::cout << "Time to build the path index: " << paths.getBuildTime() << " ms (" << paths.size()
+              << " paths, " << paths.getBytes() << " bytes)" << std::endl;
+}
+
+// evaluate the query and write its answer pairs to the file of the query as they are found
+cardStat streamQuery(std::unique_ptr<SimpleEvaluator> &ev, RPQTree *queryTree, query &q, const outputOptions &output, uint32_t queryNo) {
+
+    std::string fileName = output.prefix + "." + std::to_string(queryNo);
+    FileSink sink(fileName, output.format);
+    auto actual = ev->stream(queryTree, sink, q.source, q.target);
+
+    std::cout << "\nResults written to " << fileName << ": " << sink.getPairsWritten() << " pairs, "
+              << sink.getStalls() << " stalls on a full queue" << std::endl;
+    return actual;
+}
 
-    std::cout << "\n(1) Reading the graph into memory and preparing the estimator...\n" << std::endl;
+// the plan of a query with its estimates, and with analyze what every operator actually did
+void printExplain(std::unique_ptr<SimpleEvaluator> &ev, RPQTree *queryTree, query &q, const std::string &explainMode, const std::string &format) {
+
+    auto plan = ev->explain(queryTree, q.source, q.target, explainMode == "analyze");
+    std::cout << (explainMode == "analyze" ? "EXPLAIN ANALYZE:" : "EXPLAIN:") << std::endl;
+    if(format == "json")
+        Explain::printJson(plan, std::cout);
+    else
+        Explain::printText(plan, std::cout);
+}
+
+int evaluatorBench(std::string &graphFile, std::string &queriesFile, uint32_t noWorkers, uint32_t cacheMB, uint32_t pathMB, uint32_t bufferMB, uint32_t sketchMB,
+                   bool pipelined, const graphOptions &layout, const outputOptions &output, const std::string &explainMode, const std::string &format) {
+
+    std::cout << "\n(1) Reading the graph into memory and preparing the evaluator...\n" << std::endl;
 
     // read the graph
     auto g = std::make_shared<SimpleGraph>();
 
     auto start = std::chrono::steady_clock::now();
     try {
-        g->readFromContiguousFile(graphFile);
+        readGraph(g, graphFile, layout);
     } catch (std::runtime_error &e) {
         std::cerr << e.what() << std::endl;
         return 0;
@@ -62,63 +401,90 @@ int estimatorBench(std::string &graphFile, std::string &queriesFile) {
 
     auto end = std::chrono::steady_clock::now();
     std::cout << "Time to read the graph into memory: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    std::cout << "Index memory: " << g->getIndexBytes() << " bytes" << (layout.compress ? " (compressed)" : "") << std::endl;
+
+    // prepare the evaluator
+    auto est = std::make_shared<SimpleEstimator>(g);
+    est->setSketchBudget((size_t) sketchMB << 20);
+    auto ev = std::make_unique<SimpleEvaluator>(g);
+    ev->attachEstimator(est);
+    auto results = attachResultCache(ev, cacheMB);
+    auto buffers = attachRelationPool(ev, bufferMB);
+    ev->setPipelining(pipelined);
+    configurePathIndex(ev, queriesFile, pathMB);
+
+    // a single query at a time, with its operators partitioned across the workers
+    if(noWorkers > 1) {
+        auto pool = std::make_shared<ThreadPool>(noWorkers);
+        ev->attachPool(pool);
+    }
 
-    // prepare the estimator
-    auto est = std::make_unique<SimpleEstimator>(g);
     start = std::chrono::steady_clock::now();
-    est->prepare();
+    ev->prepare();
     end = std::chrono::steady_clock::now();
-    std::cout << "Time to prepare the estimator: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    std::cout << "Time to prepare the evaluator: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    printPathIndex(ev);
 
     std::cout << "\n(2) Running the query workload..." << std::endl;
 
+    uint32_t queryNo = 0;
     for(auto query : parseQueries(queriesFile)) {
 
+        queryNo++;
+
         // perform estimation
         // parse the query into an AST
         std::cout << "\nProcessing query: ";
         query.print();
+        if(!query.bind(g->getNoVertices())) continue;
         RPQTree *queryTree = RPQTree::strToTree(query.path);
+        if(queryTree == nullptr) continue;
         std::cout << "Parsed query tree: ";
         queryTree->print();
 
+        // perform the evaluation
         start = std::chrono::steady_clock::now();
-        auto estimate = est->estimate(queryTree);
-        end = std::chrono::steady_clock::now();
-
-        std::cout << "\nEstimation (noOut, noPaths, noIn) : ";
-        estimate.print();
-        std::cout << "Time to estimate: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
-
-        // perform evaluation
-        auto ev = std::make_unique<SimpleEvaluator>(g);
-        ev->prepare();
-        start = std::chrono::steady_clock::now();
-        auto actual = ev->evaluate(queryTree);
+        cardStat actual;
+        try {
+            if(output.prefix.empty())
+                actual = ev->evaluate(queryTree, query.source, query.target);
+            else
+                actual = streamQuery(ev, queryTree, query, output, queryNo);
+        } catch (std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            delete(queryTree);
+            return 1;
+        }
         end = std::chrono::steady_clock::now();
 
-        std::cout << "Actual (noOut, noPaths, noIn) : ";
+        std::cout << "\nActual (noOut, noPaths, noIn) : ";
         actual.print();
         std::cout << "Time to evaluate: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
 
+        if(!explainMode.empty()) printExplain(ev, queryTree, query, explainMode, format);
+
         // clean-up
         delete(queryTree);
 
     }
 
+    printPlanCache(ev->getPlanCache());
+    printResultCache(results);
+    printRelationPool(buffers);
+
     return 0;
 }
 
-int evaluatorBench(std::string &graphFile, std::string &queriesFile) {
+// run the whole workload on a pool of threads sharing one prepared graph, estimator and evaluator
+int concurrentBench(std::string &graphFile, std::string &queriesFile, uint32_t noThreads, uint32_t cacheMB, uint32_t pathMB, uint32_t bufferMB, uint32_t sketchMB, bool pipelined, const graphOptions &layout) {
 
     std::cout << "\n(1) Reading the graph into memory and preparing the evaluator...\n" << std::endl;
 
-    // read the graph
     auto g = std::make_shared<SimpleGraph>();
 
     auto start = std::chrono::steady_clock::now();
     try {
-        g->readFromContiguousFile(graphFile);
+        readGraph(g, graphFile, layout);
     } catch (std::runtime_error &e) {
         std::cerr << e.what() << std::endl;
         return 0;
@@ -126,59 +492,224 @@ int evaluatorBench(std::string &graphFile, std::string &queriesFile) {
 
     auto end = std::chrono::steady_clock::now();
     std::cout << "Time to read the graph into memory: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    std::cout << "Index memory: " << g->getIndexBytes() << " bytes" << (layout.compress ? " (compressed)" : "") << std::endl;
 
-    // prepare the evaluator
     auto est = std::make_shared<SimpleEstimator>(g);
+    est->setSketchBudget((size_t) sketchMB << 20);
     auto ev = std::make_unique<SimpleEvaluator>(g);
     ev->attachEstimator(est);
+    auto cache = attachResultCache(ev, cacheMB);
+    auto buffers = attachRelationPool(ev, bufferMB);
+    ev->setPipelining(pipelined);
+    configurePathIndex(ev, queriesFile, pathMB);
 
     start = std::chrono::steady_clock::now();
     ev->prepare();
     end = std::chrono::steady_clock::now();
     std::cout << "Time to prepare the evaluator: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    printPathIndex(ev);
 
-    std::cout << "\n(2) Running the query workload..." << std::endl;
+    auto queries = parseQueries(queriesFile);
+    std::vector<RPQTree*> trees;
+    for(auto &query : queries)
+        trees.push_back(query.bind(g->getNoVertices()) ? RPQTree::strToTree(query.path) : nullptr);
 
-    for(auto query : parseQueries(queriesFile)) {
+    std::vector<cardStat> results(queries.size(), cardStat{0, 0, 0});
+    std::vector<double> times(queries.size(), 0);
 
-        // perform estimation
-        // parse the query into an AST
+    ThreadPool pool(noThreads);
+    std::cout << "\n(2) Running the query workload on " << pool.size() << " threads..." << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < queries.size(); i++) {
+        if(trees[i] == nullptr) continue;
+        pool.submit([&, i]() {
+            auto queryStart = std::chrono::steady_clock::now();
+            results[i] = ev->evaluate(trees[i], queries[i].source, queries[i].target);
+            times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+        });
+    }
+    pool.wait();
+    end = std::chrono::steady_clock::now();
+
+    for(uint32_t i = 0; i < queries.size(); i++) {
         std::cout << "\nProcessing query: ";
-        query.print();
-        RPQTree *queryTree = RPQTree::strToTree(query.path);
-        std::cout << "Parsed query tree: ";
-        queryTree->print();
+        queries[i].print();
+        if(trees[i] == nullptr) continue;
+        std::cout << "Actual (noOut, noPaths, noIn) : ";
+        results[i].print();
+        std::cout << "Time to evaluate: " << times[i] << " ms" << std::endl;
+        delete(trees[i]);
+    }
 
-        // perform the evaluation
-        start = std::chrono::steady_clock::now();
-        auto actual = ev->evaluate(queryTree);
-        end = std::chrono::steady_clock::now();
+    double total = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "\nTotal time to evaluate the workload: " << total << " ms" << std::endl;
+    std::cout << "Throughput: " << (total > 0 ? queries.size() * 1000.0 / total : 0) << " queries/s" << std::endl;
 
-        std::cout << "\nActual (noOut, noPaths, noIn) : ";
-        actual.print();
-        std::cout << "Time to evaluate: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    printPlanCache(ev->getPlanCache());
+    printResultCache(cache);
+    printRelationPool(buffers);
 
-        // clean-up
-        delete(queryTree);
+    return 0;
+}
+
+int snapshot(std::string &graphFile, std::string &snapshotFile) {
 
+    auto g = std::make_shared<SimpleGraph>();
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        readGraph(g, graphFile);
+        g->writeSnapshot(snapshotFile);
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 0;
     }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "Time to write the graph snapshot: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
 
     return 0;
 }
 
+void usage() {
+    std::cout << "Usage: quicksilver <graphFile> <queriesFile> [--threads N] [--parallel N] [--result-cache MB] [--path-index MB]" << std::endl;
+    std::cout << "                   [--buffer-pool MB] [--sketch-budget MB] [--pipeline] [--compress]" << std::endl;
+    std::cout << "                   [--reorder original|degree|bfs|rcm] [--verify] [--output PREFIX] [--output-format text|binary]" << std::endl;
+    std::cout << "       quicksilver <graphFile> <queriesFile> --explain[=analyze] [--format text|json]" << std::endl;
+    std::cout << "       quicksilver <graphFile> <queriesFile> --bench=estimator [--sketch-budget MB] [--format csv|json] [--warmup N] [--iterations N]" << std::endl;
+    std::cout << "       quicksilver --snapshot <graphFile> <snapshotFile>" << std::endl;
+}
 
 int main(int argc, char *argv[]) {
 
     if(argc < 3) {
-        std::cout << "Usage: quicksilver <graphFile> <queriesFile>" << std::endl;
+        usage();
         return 0;
     }
 
+    if(std::string(argv[1]) == "--snapshot") {
+        if(argc < 4) {
+            std::cout << "Usage: quicksilver --snapshot <graphFile> <snapshotFile>" << std::endl;
+            return 0;
+        }
+        std::string graphFile {argv[2]};
+        std::string snapshotFile {argv[3]};
+        return snapshot(graphFile, snapshotFile);
+    }
+
     // args
     std::string graphFile {argv[1]};
     std::string queriesFile {argv[2]};
 
-    evaluatorBench(graphFile, queriesFile);
+    uint32_t noThreads = 1;
+    uint32_t noWorkers = 1;
+    uint32_t cacheMB = 0;
+    uint32_t pathMB = 0;
+    uint32_t bufferMB = 64;
+    uint32_t sketchMB = 64;
+    bool pipelined = false;
+    graphOptions layout;
+    std::string ordering = "original";
+    outputOptions output;
+    std::string outputFormat = "text";
+    std::string bench = "evaluator";
+    std::string format;
+    std::string explainMode;
+    uint32_t warmup = 2;
+    uint32_t iterations = 10;
+    try {
+        for(int i = 3; i < argc; i++) {
+            std::string arg {argv[i]};
+            std::string value;
+            auto equals = arg.find('=');
+            bool hasValue = equals != std::string::npos;
+            if(hasValue) {
+                value = arg.substr(equals + 1);
+                arg = arg.substr(0, equals);
+            }
+
+            // flags, --explain optionally with a mode
+            if(arg == "--pipeline" && !hasValue) pipelined = true;
+            else if(arg == "--compress" && !hasValue) layout.compress = true;
+            else if(arg == "--verify" && !hasValue) layout.verify = true;
+            else if(arg == "--explain") {
+                if(hasValue && value != "analyze") {
+                    std::cerr << "Unknown explain mode: " << value << std::endl;
+                    usage();
+                    return 1;
+                }
+                explainMode = hasValue ? "analyze" : "plan";
+            }
+            else {
+                if(!hasValue && i + 1 < argc) value = argv[++i];
+
+                if(arg == "--threads") noThreads = (uint32_t) std::stoul(value);
+                else if(arg == "--parallel") noWorkers = (uint32_t) std::stoul(value);
+                else if(arg == "--result-cache") cacheMB = (uint32_t) std::stoul(value);
+                else if(arg == "--path-index") pathMB = (uint32_t) std::stoul(value);
+                else if(arg == "--buffer-pool") bufferMB = (uint32_t) std::stoul(value);
+                else if(arg == "--sketch-budget") sketchMB = (uint32_t) std::stoul(value);
+                else if(arg == "--reorder") ordering = value;
+                else if(arg == "--output") output.prefix = value;
+                else if(arg == "--output-format") outputFormat = value;
+                else if(arg == "--bench") bench = value;
+                else if(arg == "--format") format = value;
+                else if(arg == "--warmup") warmup = (uint32_t) std::stoul(value);
+                else if(arg == "--iterations") iterations = (uint32_t) std::stoul(value);
+                else {
+                    std::cerr << "Unknown option: " << argv[i] << std::endl;
+                    usage();
+                    return 1;
+                }
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if(bench != "evaluator" && bench != "estimator") {
+        std::cerr << "Unknown benchmark: " << bench << std::endl;
+        usage();
+        return 1;
+    }
+
+    // --format is read by the estimator bench and by --explain, and they know different formats
+    bool estimating = bench == "estimator";
+    if(!format.empty() && !(estimating ? format == "csv" || format == "json" : format == "text" || format == "json")) {
+        std::cerr << "Unknown format: " << format << std::endl;
+        usage();
+        return 1;
+    }
+
+    // the concurrent workload neither explains nor streams its queries, and the estimator bench only estimates
+    std::string conflict;
+    if(estimating && (noThreads != 1 || !explainMode.empty() || !output.prefix.empty())) conflict = "--bench=estimator cannot be combined with --threads, --explain or --output";
+    else if(noThreads != 1 && (!explainMode.empty() || !output.prefix.empty() || noWorkers != 1)) conflict = "--threads cannot be combined with --explain, --output or --parallel";
+    else if(!estimating && explainMode.empty() && !format.empty()) conflict = "--format needs --explain or --bench=estimator";
+    if(!conflict.empty()) {
+        std::cerr << conflict << std::endl;
+        usage();
+        return 1;
+    }
+
+    if(!SimpleGraph::parseOrdering(ordering, layout.order)) {
+        std::cerr << "Unknown vertex ordering: " << ordering << std::endl;
+        return 1;
+    }
+
+    if(!FileSink::parseFormat(outputFormat, output.format)) {
+        std::cerr << "Unknown output format: " << outputFormat << std::endl;
+        return 1;
+    }
+
+    if(bench == "estimator")
+        estimatorBench(graphFile, queriesFile, sketchMB, format, warmup, iterations);
+    else if(noThreads != 1)
+        concurrentBench(graphFile, queriesFile, noThreads, cacheMB, pathMB, bufferMB, sketchMB, pipelined, layout);
+    else
+        return evaluatorBench(graphFile, queriesFile, noWorkers, cacheMB, pathMB, bufferMB, sketchMB, pipelined, layout, output, explainMode, format);
 
     return 0;
 }
@@ -0,0 +1,517 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <SimpleGraph.h>
+#include <SimpleEstimator.h>
+#include <SimpleEvaluator.h>
+#include <JoinKernels.h>
+#include <RelationPool.h>
+#include <GraphGenerator.h>
+
+// every allocation of the process goes through these, so a benchmark can count its own. The
+// replacements are kept out of line: inlined into a caller, free() on a pointer from new is taken
+// for a mismatched pair. The aligned forms are C++17 and not used by the engine.
+static std::atomic<uint64_t> allocations {0};
+static std::atomic<uint64_t> allocatedBytes {0};
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = std::malloc(size > 0 ? size : 1);
+    if(p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+// one operation to time, returning how many items (edges, tuples, queries) it processed
+struct benchmark {
+    std::string name;
+    std::string unit;
+    std::function<uint64_t()> op;
+};
+
+struct measurement {
+    std::string name;
+    std::string unit;
+    uint64_t iterations = 0;
+    double nsPerOp = 0;        // median over the iterations
+    double itemsPerSecond = 0; // at the median time
+    double allocsPerOp = 0;
+    double bytesPerOp = 0;
+    double missesPerOp = -1;   // hardware cache misses, -1 where the counter is not available
+};
+
+// cache misses of the calling thread in user space, from the hardware counters
+class missCounter {
+    int fd = -1;
+public:
+    missCounter() {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~missCounter() {
+        if(fd >= 0) close(fd);
+    }
+    bool available() const { return fd >= 0; }
+    void start() {
+        if(fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t stop() {
+        uint64_t count = 0;
+        if(fd < 0) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+        return count;
+    }
+};
+
+struct benchOptions {
+    std::string graphFile;   // generated when empty
+    std::string queriesFile; // generated when empty
+    std::string filter;
+    std::string saveFile;
+    std::string baselineFile;
+    double threshold = 0.10; // slowdown over the baseline that counts as a regression
+    double minTime = 0.5;    // seconds per benchmark, after one warm-up run
+    uint32_t minIterations = 3;
+    uint32_t maxIterations = 1000;
+    uint32_t scale = 1;
+    uint64_t seed = 42;
+};
+
+// one warm-up run, then runs until both the minimum time and the minimum number of iterations are reached
+measurement run(const benchmark &b, const benchOptions &options) {
+
+    b.op();
+
+    std::vector<double> times;
+    uint64_t items = 0;
+    double total = 0;
+    auto allocationsBefore = allocations.load();
+    auto bytesBefore = allocatedBytes.load();
+    missCounter misses;
+    uint64_t totalMisses = 0;
+
+    while(times.size() < options.maxIterations && (total < options.minTime || times.size() < options.minIterations)) {
+        misses.start();
+        auto start = std::chrono::steady_clock::now();
+        items = b.op();
+        auto end = std::chrono::steady_clock::now();
+        totalMisses += misses.stop();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        times.push_back(seconds);
+        total += seconds;
+    }
+
+    measurement m;
+    m.name = b.name;
+    m.unit = b.unit;
+    m.iterations = times.size();
+
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    double median = times[times.size() / 2];
+    m.nsPerOp = median * 1e9;
+    m.itemsPerSecond = median > 0 ? items / median : 0;
+    m.allocsPerOp = (double) (allocations.load() - allocationsBefore) / m.iterations;
+    m.bytesPerOp = (double) (allocatedBytes.load() - bytesBefore) / m.iterations;
+    if(misses.available()) m.missesPerOp = (double) totalMisses / m.iterations;
+
+    return m;
+}
+
+// a relation of n (source, key) pairs with keys drawn uniformly or by Zipf(1.1) from n / 4 keys,
+// sorted and without duplicates
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> keyedRelation(uint32_t n, bool skewed, uint64_t seed) {
+
+    std::mt19937_64 rng(seed);
+    uint32_t noKeys = std::max(1u, n / 4);
+    ZipfSampler keys(noKeys, 1.1);
+
+    auto relation = std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
+    relation->reserve(n);
+    for(uint32_t i = 0; i < n; i ++) {
+        auto key = skewed ? (uint32_t) keys.sample(rng) - 1 : (uint32_t) (rng() % noKeys);
+        relation->emplace_back((uint32_t) (rng() % n), key);
+    }
+    JoinKernels::sortUnique(*relation);
+    return relation;
+}
+
+// two targets for every one of the n / 4 keys, so the join output stays proportional to the input
+std::shared_ptr<std::vector<std::pair<uint32_t,uint32_t>>> fanOut(uint32_t n, uint64_t seed) {
+
+    std::mt19937_64 rng(seed);
+    uint32_t noKeys = std::max(1u, n / 4);
+
+    auto relation = std::make_shared<std::vector<std::pair<uint32_t,uint32_t>>>();
+    for(uint32_t key = 0; key < noKeys; key ++) {
+        relation->emplace_back(key, (uint32_t) (rng() % n));
+        relation->emplace_back(key, (uint32_t) (rng() % n));
+    }
+    JoinKernels::sortUnique(*relation);
+    return relation;
+}
+
+std::vector<RPQTree*> readQueries(const std::string &fileName, std::vector<std::pair<uint32_t,uint32_t>> &ends) {
+
+    std::vector<RPQTree*> trees;
+    std::ifstream in(fileName);
+    std::regex queryPat (R"(([^,]+),(.+),([^,]+))");
+
+    auto vertex = [](const std::string &end) { return end == "*" ? ANY_VERTEX : (uint32_t) std::stoul(end); };
+
+    std::string line;
+    while(std::getline(in, line)) {
+        std::smatch matches;
+        if(!std::regex_search(line, matches, queryPat)) continue;
+        std::string path = matches[2];
+        auto tree = RPQTree::strToTree(path);
+        if(tree == nullptr) continue;
+        trees.push_back(tree);
+        ends.emplace_back(vertex(matches[1]), vertex(matches[3]));
+    }
+    return trees;
+}
+
+std::vector<measurement> readBaseline(const std::string &fileName) {
+
+    std::vector<measurement> baseline;
+    std::ifstream in(fileName);
+    std::string line;
+    std::getline(in, line); // header
+
+    while(std::getline(in, line)) {
+        std::stringstream fields(line);
+        measurement m;
+        std::string value;
+        std::getline(fields, m.name, ',');
+        std::getline(fields, m.unit, ',');
+        std::getline(fields, value, ',');
+        m.iterations = std::stoull(value);
+        std::getline(fields, value, ',');
+        m.nsPerOp = std::stod(value);
+        std::getline(fields, value, ',');
+        m.itemsPerSecond = std::stod(value);
+        std::getline(fields, value, ',');
+        m.allocsPerOp = std::stod(value);
+        std::getline(fields, value, ',');
+        m.bytesPerOp = std::stod(value);
+        if(std::getline(fields, value, ',')) m.missesPerOp = std::stod(value);
+        baseline.push_back(m);
+    }
+    return baseline;
+}
+
+void writeResults(const std::string &fileName, const std::vector<measurement> &results) {
+
+    std::ofstream out(fileName);
+    out << "name,unit,iterations,ns_per_op,items_per_s,allocs_per_op,bytes_per_op,misses_per_op" << std::endl;
+    out << std::setprecision(10);
+    for(auto &m : results)
+        out << m.name << "," << m.unit << "," << m.iterations << "," << m.nsPerOp << "," << m.itemsPerSecond
+            << "," << m.allocsPerOp << "," << m.bytesPerOp << "," << m.missesPerOp << std::endl;
+}
+
+void usage() {
+    std::cout << "Usage: qsbench [--graph FILE] [--queries FILE] [--scale N] [--seed N] [--filter TEXT]" << std::endl;
+    std::cout << "               [--min-time SECONDS] [--save FILE] [--baseline FILE] [--threshold FRACTION]" << std::endl;
+    std::cout << "Without a graph or queries file, they are generated (100k vertices and 500k edges per unit of scale)." << std::endl;
+    std::cout << "With a baseline, exits with status 1 when a benchmark is slower by more than the threshold." << std::endl;
+    std::cout << "The workload/* benchmarks run the queries over each vertex numbering (see --reorder of quicksilver);" << std::endl;
+    std::cout << "misses/op is read from the hardware counters and is n/a where they cannot be opened." << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+    benchOptions options;
+    try {
+        for(int i = 1; i < argc; i++) {
+            std::string arg {argv[i]};
+            std::string value;
+            auto equals = arg.find('=');
+            if(equals != std::string::npos) {
+                value = arg.substr(equals + 1);
+                arg = arg.substr(0, equals);
+            } else if(i + 1 < argc && arg != "--help") {
+                value = argv[++i];
+            }
+
+            if(arg == "--graph") options.graphFile = value;
+            else if(arg == "--queries") options.queriesFile = value;
+            else if(arg == "--scale") options.scale = std::max(1u, (uint32_t) std::stoul(value));
+            else if(arg == "--seed") options.seed = std::stoull(value);
+            else if(arg == "--filter") options.filter = value;
+            else if(arg == "--min-time") options.minTime = std::stod(value);
+            else if(arg == "--save") options.saveFile = value;
+            else if(arg == "--baseline") options.baselineFile = value;
+            else if(arg == "--threshold") options.threshold = std::stod(value);
+            else {
+                usage();
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // generated inputs go to the temporary directory and are removed at the end
+    std::vector<std::string> generated;
+    const char *tmp = std::getenv("TMPDIR");
+    std::string prefix = std::string(tmp != nullptr ? tmp : "/tmp") + "/qsbench-" + std::to_string(getpid());
+
+    if(options.graphFile.empty() || options.queriesFile.empty()) {
+        generatorConfig config;
+        config.seed = options.seed;
+        config.noVertices = 100000 * options.scale;
+        config.noEdges = 500000ull * options.scale;
+        config.noLabels = 4;
+        labelDistribution zipf, powerLaw, uniform;
+        labelDistribution::parse("zipf:1.1", zipf);
+        labelDistribution::parse("powerlaw:2.5", powerLaw);
+        config.distributions = {zipf, powerLaw, uniform};
+        config.noQueries = 50;
+        config.minChain = 2;
+        config.maxChain = 5;
+
+        GraphGenerator generator(config);
+        if(options.graphFile.empty()) {
+            options.graphFile = prefix + ".nt";
+            std::ofstream out(options.graphFile, std::ios::binary);
+            generator.writeGraph(out);
+            generated.push_back(options.graphFile);
+        }
+        if(options.queriesFile.empty()) {
+            options.queriesFile = prefix + ".csv";
+            std::ofstream out(options.queriesFile);
+            generator.writeQueries(out);
+            generated.push_back(options.queriesFile);
+        }
+    }
+
+    auto g = std::make_shared<SimpleGraph>();
+    auto packed = std::make_shared<SimpleGraph>();
+    packed->setCompression(true);
+    try {
+        g->readFromContiguousFile(options.graphFile);
+        packed->readFromContiguousFile(options.graphFile);
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<uint32_t,uint32_t>> ends;
+    auto queries = readQueries(options.queriesFile, ends);
+
+    auto est = std::make_shared<SimpleEstimator>(g);
+    auto ev = std::make_unique<SimpleEvaluator>(g);
+    ev->attachEstimator(est);
+    ev->prepare();
+
+    // the pooled variants reuse the outputs of earlier iterations
+    auto buffers = std::make_shared<RelationPool>((size_t) 256 << 20);
+
+    std::vector<benchmark> benchmarks;
+
+    benchmarks.push_back({"load/text", "edges", [&]() {
+        auto loaded = std::make_shared<SimpleGraph>();
+        loaded->readFromContiguousFile(options.graphFile);
+        return (uint64_t) loaded->getNoEdges();
+    }});
+
+    for(bool pooled : {false, true}) {
+        for(bool inverse : {false, true}) {
+            std::string name = std::string(inverse ? "project/rev" : "project/fwd") + (pooled ? "/pooled" : "");
+            benchmarks.push_back({name, "edges", [&, inverse, pooled]() {
+                uint64_t items = 0;
+                for(uint32_t label = 0; label < g->getNoLabels(); label ++)
+                    items += SimpleEvaluator::project(label, inverse, g, nullptr, pooled ? buffers.get() : nullptr)->size();
+                return items;
+            }});
+        }
+    }
+
+    // decoding the delta + varint coded lists instead of copying the plain ones
+    for(bool inverse : {false, true}) {
+        benchmarks.push_back({inverse ? "project/rev/compressed" : "project/fwd/compressed", "edges", [&, inverse]() {
+            uint64_t items = 0;
+            for(uint32_t label = 0; label < packed->getNoLabels(); label ++)
+                items += SimpleEvaluator::project(label, inverse, packed)->size();
+            return items;
+        }});
+    }
+
+    for(uint32_t n : {1u << 12, 1u << 16, 1u << 20}) {
+        for(bool skewed : {false, true}) {
+            auto left = keyedRelation(n * options.scale, skewed, options.seed);
+            auto right = fanOut(n * options.scale, options.seed + 1);
+            for(bool pooled : {false, true}) {
+                std::string name = "join/" + std::to_string(n * options.scale) + (skewed ? "/zipf" : "/uniform") + (pooled ? "/pooled" : "");
+                RelationPool *from = pooled ? buffers.get() : nullptr;
+                benchmarks.push_back({name, "tuples", [left, right, from]() mutable {
+                    SimpleEvaluator::join(left, right, nullptr, nullptr, from);
+                    return (uint64_t) (left->size() + right->size());
+                }});
+            }
+        }
+    }
+
+    benchmarks.push_back({"estimator/prepare", "edges", [&]() {
+        est->prepare();
+        return (uint64_t) g->getNoEdges();
+    }});
+
+    benchmarks.push_back({"estimator/estimate", "queries", [&]() {
+        for(size_t i = 0; i < queries.size(); i ++)
+            est->estimate(queries[i], ends[i].first, ends[i].second);
+        return (uint64_t) queries.size();
+    }});
+
+    // planning from scratch, then replaying the cached join orders
+    for(bool cached : {false, true}) {
+        benchmarks.push_back({cached ? "optimizer/cached" : "optimizer/plan", "queries", [&, cached]() {
+            if(!cached) ev->getPlanCache().clear();
+            for(auto query : queries) {
+                auto plan = ev->optimize(query);
+                if(plan != query) SimpleEvaluator::releasePlan(plan);
+            }
+            return (uint64_t) queries.size();
+        }});
+    }
+
+    // the workload with every join materialized, then with the chains of labels streamed in batches
+    for(bool streamed : {false, true}) {
+        benchmarks.push_back({streamed ? "evaluate/pipelined" : "evaluate/materialized", "queries", [&, streamed]() {
+            ev->setPipelining(streamed);
+            for(size_t i = 0; i < queries.size(); i ++)
+                ev->evaluate(queries[i], ends[i].first, ends[i].second);
+            ev->setPipelining(false);
+            return (uint64_t) queries.size();
+        }});
+    }
+
+    // the answers of the workload handed to a callback, against evaluate/materialized that only counts them
+    benchmarks.push_back({"evaluate/streamed", "queries", [&]() {
+        uint64_t noPairs = 0;
+        CallbackSink sink([&](const std::pair<uint32_t,uint32_t> *, size_t count) { noPairs += count; });
+        for(size_t i = 0; i < queries.size(); i ++)
+            ev->stream(queries[i], sink, ends[i].first, ends[i].second);
+        return (uint64_t) queries.size();
+    }});
+
+    // the whole workload over each vertex numbering; the graph is loaded, renumbered and prepared in
+    // the warm-up run, so only the benchmarks that are run pay for it
+    struct numbering {
+        std::shared_ptr<SimpleGraph> graph;
+        std::shared_ptr<SimpleEstimator> est;
+        std::unique_ptr<SimpleEvaluator> ev;
+    };
+    const char *orderings[] = {"original", "degree", "bfs", "rcm"};
+    for(auto order : {SimpleGraph::ORIGINAL, SimpleGraph::DEGREE, SimpleGraph::BFS, SimpleGraph::RCM}) {
+        auto state = std::make_shared<numbering>();
+        benchmarks.push_back({std::string("workload/") + orderings[order], "queries", [&, state, order]() {
+            if(state->ev == nullptr) {
+                state->graph = std::make_shared<SimpleGraph>();
+                state->graph->readFromContiguousFile(options.graphFile);
+                state->graph->reorder(order);
+                state->est = std::make_shared<SimpleEstimator>(state->graph);
+                state->ev = std::make_unique<SimpleEvaluator>(state->graph);
+                state->ev->attachEstimator(state->est);
+                state->ev->prepare();
+            }
+            for(size_t i = 0; i < queries.size(); i ++)
+                state->ev->evaluate(queries[i], ends[i].first, ends[i].second);
+            return (uint64_t) queries.size();
+        }});
+    }
+
+    std::map<std::string, measurement> baseline;
+    if(!options.baselineFile.empty()) {
+        try {
+            for(auto &m : readBaseline(options.baselineFile))
+                baseline[m.name] = m;
+        } catch (std::exception &e) {
+            std::cerr << "Invalid baseline file: " << options.baselineFile << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << std::left << std::setw(24) << "benchmark" << std::right << std::setw(8) << "iters" << std::setw(16) << "ns/op"
+              << std::setw(20) << "items/s" << std::setw(14) << "allocs/op" << std::setw(16) << "bytes/op" << std::setw(16) << "misses/op";
+    if(!baseline.empty()) std::cout << std::setw(10) << "change";
+    std::cout << std::endl;
+
+    std::vector<measurement> results;
+    bool regressed = false;
+    for(auto &b : benchmarks) {
+        if(!options.filter.empty() && b.name.find(options.filter) == std::string::npos) continue;
+
+        auto m = run(b, options);
+        results.push_back(m);
+
+        std::cout << std::left << std::setw(24) << m.name << std::right << std::setw(8) << m.iterations
+                  << std::fixed << std::setprecision(0) << std::setw(16) << m.nsPerOp
+                  << std::setw(20) << (std::to_string((uint64_t) m.itemsPerSecond) + " " + m.unit + "/s")
+                  << std::setprecision(1) << std::setw(14) << m.allocsPerOp << std::setprecision(0) << std::setw(16) << m.bytesPerOp
+                  << std::setw(16) << (m.missesPerOp < 0 ? std::string("n/a") : std::to_string((uint64_t) m.missesPerOp));
+
+        auto it = baseline.find(m.name);
+        if(it != baseline.end() && it->second.nsPerOp > 0) {
+            double change = m.nsPerOp / it->second.nsPerOp - 1;
+            std::cout << std::showpos << std::setprecision(1) << std::setw(9) << 100 * change << "%" << std::noshowpos;
+            if(change > options.threshold) {
+                std::cout << "  REGRESSION";
+                regressed = true;
+            }
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    if(!options.saveFile.empty())
+        writeResults(options.saveFile, results);
+
+    for(auto query : queries)
+        delete(query);
+    for(auto &file : generated)
+        std::remove(file.c_str());
+
+    return regressed ? 1 : 0;
+}